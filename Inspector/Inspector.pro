@@ -0,0 +1,52 @@
+TEMPLATE = app
+
+CONFIG -= QT
+QT -= core gui
+
+CONFIG += console debug_and_release
+CONFIG -= flat
+
+win32 {
+    # Treat all source files as C++
+    QMAKE_CXXFLAGS += /TP
+
+    # Define warning level
+    QMAKE_CXXFLAGS_WARN_ON  = /W4
+    # 'identifier' : unreferenced formal parameter
+    QMAKE_CXXFLAGS_WARN_ON += /wd4100
+    # 'function': This function or variable may be unsafe
+    QMAKE_CXXFLAGS_WARN_ON += /wd4996
+}
+unix {
+    # Enable C++11 support
+    QMAKE_CXXFLAGS += -std=c++11
+    QMAKE_CXXFLAGS += -pthread
+    QMAKE_LFLAGS += -pthread
+}
+linux {
+    # 'shm_open()' on older glibc
+    LIBS += -lrt
+}
+
+# ==================================================================================================
+
+# Reads layout of shared memory segments from the prototype (field sizes are taken from 'StateDb'
+# itself so that reader and writer agree)
+PROTOTYPE = ../Prototype
+
+INCLUDEPATH += $${PROTOTYPE}
+
+HEADERS += \
+    $${PROTOTYPE}/Common.hpp \
+    $${PROTOTYPE}/JobSystem.hpp \
+    $${PROTOTYPE}/Logger.hpp \
+    $${PROTOTYPE}/Platform.hpp \
+    $${PROTOTYPE}/StateDb.hpp \
+    $${PROTOTYPE}/StateDbMirror.hpp
+
+SOURCES += \
+    Main.cpp \
+    $${PROTOTYPE}/JobSystem.cpp \
+    $${PROTOTYPE}/Logger.cpp \
+    $${PROTOTYPE}/Platform.cpp \
+    $${PROTOTYPE}/StateDb.cpp
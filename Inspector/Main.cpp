@@ -0,0 +1,271 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#include "Common.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Platform.hpp"
+#include "StateDb.hpp"
+#include "StateDbMirror.hpp"
+
+// -------------------------------------------------------------------------------------------------
+/// Consistent copy of mirror segment (and optionally of one state element) taken between frames
+struct Snapshot
+{
+    std::unique_ptr< StateDbMirrorLayout::Segment > segment;
+    std::vector< unsigned char > elem;
+    const StateDbMirrorLayout::State* state = nullptr;
+};
+
+// -------------------------------------------------------------------------------------------------
+static const StateDbMirrorLayout::State* findState(
+    const StateDbMirrorLayout::Segment& segment, const std::string& name )
+{
+    for ( u64 stateIdx = 0; stateIdx < segment.header.stateCount; ++stateIdx ) {
+        if ( name == segment.states[ stateIdx ].name ) {
+            return &segment.states[ stateIdx ];
+        }
+    }
+    return nullptr;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Reads mirror like a sequence lock (writer never waits for us, we retry while it is modifying)
+static bool readSnapshot(
+    const StateDbMirrorLayout::Segment* mirror, const unsigned char* arena, u64 arenaSizeInB,
+    const std::string& stateName, u64 objectIdx, Snapshot& snapshot )
+{
+    for ( int attempt = 0; attempt < 1000; ++attempt ) {
+        u64 generation = mirror->header.generation.load( std::memory_order_acquire );
+        if ( generation % 2 != 0 ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            continue;
+        }
+
+        // Atomic generation is not trivially copyable ==> copy raw bytes
+        memcpy( (void*)snapshot.segment.get(), mirror, sizeof( StateDbMirrorLayout::Segment ) );
+        const StateDbMirrorLayout::Header& header = snapshot.segment->header;
+
+        snapshot.state = nullptr;
+        snapshot.elem.clear();
+        if ( !stateName.empty() && header.stateCount <= StateDbMirrorLayout::MAX_STATE_COUNT ) {
+            snapshot.state = findState( *snapshot.segment, stateName );
+        }
+        const StateDbMirrorLayout::State* state = snapshot.state;
+        bool typeIdValid =
+            state && state->typeId >= 1 && state->typeId <= header.typeCount
+            && header.typeCount <= StateDbMirrorLayout::MAX_TYPE_COUNT;
+        if ( arena && typeIdValid && state->valuesOffsetInB && objectIdx >= 1
+             && objectIdx <= snapshot.segment->types[ state->typeId - 1 ].objectCount ) {
+            u64 offsetInB = state->valuesOffsetInB + objectIdx * state->elemSize;
+            if ( offsetInB + state->elemSize <= arenaSizeInB ) {
+                snapshot.elem.resize( state->elemSize );
+                memcpy( snapshot.elem.data(), arena + offsetInB, snapshot.elem.size() );
+            }
+        }
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if ( mirror->header.generation.load( std::memory_order_relaxed ) == generation ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+static std::string formatField(
+    const StateDbMirrorLayout::Field& field, const std::vector< unsigned char >& elem )
+{
+    std::string result;
+    char buffer[ 64 ];
+    for ( u64 componentIdx = 0; componentIdx < field.count; ++componentIdx ) {
+        const unsigned char* data = elem.data() + field.offsetInB;
+        switch ( StateDb::Field::Type( field.type ) ) {
+        case StateDb::Field::Type::U32: {
+            u32 value = 0;
+            memcpy( &value, data + componentIdx * sizeof( u32 ), sizeof( u32 ) );
+            snprintf( buffer, sizeof( buffer ), "%llu", (unsigned long long)value );
+            break;
+        }
+        case StateDb::Field::Type::S32: {
+            s32 value = 0;
+            memcpy( &value, data + componentIdx * sizeof( s32 ), sizeof( s32 ) );
+            snprintf( buffer, sizeof( buffer ), "%lld", (long long)value );
+            break;
+        }
+        case StateDb::Field::Type::U64:
+        case StateDb::Field::Type::HANDLE: {
+            u64 value = 0;
+            memcpy( &value, data + componentIdx * sizeof( u64 ), sizeof( u64 ) );
+            snprintf( buffer, sizeof( buffer ), "0x%016llx", (unsigned long long)value );
+            break;
+        }
+        case StateDb::Field::Type::S64: {
+            s64 value = 0;
+            memcpy( &value, data + componentIdx * sizeof( s64 ), sizeof( s64 ) );
+            snprintf( buffer, sizeof( buffer ), "%lld", (long long)value );
+            break;
+        }
+        case StateDb::Field::Type::F32: {
+            float value = 0.0f;
+            memcpy( &value, data + componentIdx * sizeof( float ), sizeof( float ) );
+            snprintf( buffer, sizeof( buffer ), "%g", double( value ) );
+            break;
+        }
+        case StateDb::Field::Type::F64: {
+            double value = 0.0;
+            memcpy( &value, data + componentIdx * sizeof( double ), sizeof( double ) );
+            snprintf( buffer, sizeof( buffer ), "%g", value );
+            break;
+        }
+        default:
+            snprintf( buffer, sizeof( buffer ), "?" );
+            break;
+        }
+        result += ( componentIdx > 0 ? " " : "" ) + std::string( buffer );
+    }
+    return result;
+}
+
+// -------------------------------------------------------------------------------------------------
+static void printSnapshot( const Snapshot& snapshot, const std::string& stateName, u64 objectIdx )
+{
+    const StateDbMirrorLayout::Segment& segment = *snapshot.segment;
+    const StateDbMirrorLayout::Header& header   = segment.header;
+    Logger::debug( "===== Frame %llu =====", (unsigned long long)header.frame );
+
+    for ( u64 typeIdx = 0; typeIdx < header.typeCount; ++typeIdx ) {
+        const StateDbMirrorLayout::Type& type = segment.types[ typeIdx ];
+        Logger::debug(
+            "%-40s %8llu / %8llu", type.name, (unsigned long long)type.objectCount,
+            (unsigned long long)type.objectCapacity );
+    }
+
+    for ( u64 sectionIdx = 0; sectionIdx < header.sectionCount; ++sectionIdx ) {
+        const StateDbMirrorLayout::Section& section = segment.sections[ sectionIdx ];
+        Logger::debug(
+            "%*s%-*s %8.3f ms", int( section.callDepth * 2 ), "", int( 40 - section.callDepth * 2 ),
+            section.name, section.exitMs - section.enterMs );
+    }
+
+    if ( stateName.empty() ) {
+        return;
+    }
+    if ( !snapshot.state ) {
+        Logger::debug( "WARNING: Unknown state \"%s\"", stateName.c_str() );
+        return;
+    }
+    if ( snapshot.elem.empty() ) {
+        Logger::debug(
+            "WARNING: Element %llu of state \"%s\" is not readable (no shared arena, split state or "
+            "object index out of range)",
+            (unsigned long long)objectIdx, stateName.c_str() );
+        return;
+    }
+    Logger::debug( "%s[ %llu ]", snapshot.state->name, (unsigned long long)objectIdx );
+    for ( u64 fieldIdx = 0; fieldIdx < snapshot.state->fieldCount; ++fieldIdx ) {
+        u64 firstFieldIdx                       = snapshot.state->firstFieldIdx;
+        const StateDbMirrorLayout::Field& field = segment.fields[ firstFieldIdx + fieldIdx ];
+        if ( field.count == 0 ) {
+            continue;
+        }
+        // Same size as 'StateDb' uses (integer typedefs are platform dependent)
+        u64 fieldSizeInB = StateDb::Field( "", StateDb::Field::Type( field.type ), field.count ).sizeInB();
+        if ( field.offsetInB + fieldSizeInB > snapshot.elem.size() ) {
+            continue;
+        }
+        Logger::debug( "    %-36s %s", field.name, formatField( field, snapshot.elem ).c_str() );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Reference reader of 'StateDbMirror' segments
+///
+///   Inspector <mirror name> [--watch] [<state name> <object index>]
+///
+/// State names are qualified by type name (e.g. "Mesh::Info"), object indices start at 1.
+int main( int argc, char* argv[] )
+{
+    Logger logging;
+
+    std::string mirrorName;
+    std::string stateName;
+    u64 objectIdx = 1;
+    bool watch    = false;
+    for ( int argIdx = 1; argIdx < argc; ++argIdx ) {
+        std::string arg = argv[ argIdx ];
+        if ( arg == "--watch" ) {
+            watch = true;
+        }
+        else if ( mirrorName.empty() ) {
+            mirrorName = arg;
+        }
+        else if ( stateName.empty() ) {
+            stateName = arg;
+        }
+        else {
+            objectIdx = u64( strtoull( arg.c_str(), nullptr, 10 ) );
+        }
+    }
+    if ( mirrorName.empty() ) {
+        Logger::debug( "Usage: Inspector <mirror name> [--watch] [<state name> <object index>]" );
+        return EXIT_FAILURE;
+    }
+
+    u64 mirrorSizeInB = 0;
+    auto mirror =
+        (const StateDbMirrorLayout::Segment*)Platform::openSharedMemory( mirrorName, mirrorSizeInB );
+    if ( !mirror ) {
+        Logger::debug( "ERROR: Failed to open mirror \"%s\"", mirrorName.c_str() );
+        return EXIT_FAILURE;
+    }
+    if ( mirrorSizeInB < sizeof( StateDbMirrorLayout::Segment )
+         || mirror->header.magic != StateDbMirrorLayout::MAGIC
+         || mirror->header.formatVersion != StateDbMirrorLayout::FORMAT_VERSION ) {
+        Logger::debug( "ERROR: Mirror \"%s\" has unsupported format", mirrorName.c_str() );
+        Platform::unmapFile( mirror, mirrorSizeInB );
+        return EXIT_FAILURE;
+    }
+
+    // Name of arena segment does not change after mirror was opened
+    const char* arenaNameChars = mirror->header.arenaName;
+    std::string arenaName( arenaNameChars, strnlen( arenaNameChars, StateDbMirrorLayout::NAME_SIZE ) );
+    u64 arenaSizeInB           = 0;
+    const unsigned char* arena = nullptr;
+    if ( !arenaName.empty() ) {
+        arena = (const unsigned char*)Platform::openSharedMemory( arenaName, arenaSizeInB );
+        if ( !arena ) {
+            Logger::debug( "WARNING: Failed to open arena \"%s\"", arenaName.c_str() );
+        }
+    }
+
+    Snapshot snapshot;
+    snapshot.segment.reset( new StateDbMirrorLayout::Segment );
+    int result = EXIT_SUCCESS;
+    do {
+        if ( !readSnapshot( mirror, arena, arenaSizeInB, stateName, objectIdx, snapshot ) ) {
+            Logger::debug( "ERROR: Mirror \"%s\" did not come to rest", mirrorName.c_str() );
+            result = EXIT_FAILURE;
+            break;
+        }
+        printSnapshot( snapshot, stateName, objectIdx );
+        if ( watch ) {
+            std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+        }
+    } while ( watch );
+
+    if ( arena ) {
+        Platform::unmapFile( arena, arenaSizeInB );
+    }
+    Platform::unmapFile( mirror, mirrorSizeInB );
+    return result;
+}
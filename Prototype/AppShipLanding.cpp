@@ -54,11 +54,15 @@ AppShipLanding::~AppShipLanding()
 // -------------------------------------------------------------------------------------------------
 void AppShipLanding::registerTypesAndStates( StateDb& sdb )
 {
-    Particle::TYPE        = sdb.registerType( "Particle", 512 );
-    Particle::Info::STATE = sdb.registerState( Particle::TYPE, "Info", sizeof( Particle::Info ) );
+    Particle::TYPE        = sdb.registerType( "Particle", 65536, StateDb::GROWABLE, 256 );
+    Particle::Info::STATE = sdb.registerState< Particle::Info >(
+        Particle::TYPE, "Info", 0,
+        { STATEDB_FIELD( Particle::Info, meshHandle, HANDLE, 1 ),
+          STATEDB_FIELD( Particle::Info, velocity, F32, 3 ), STATEDB_FIELD( Particle::Info, ageInS, F64, 1 ),
+          STATEDB_FIELD( Particle::Info, minSize, F32, 1 ), STATEDB_FIELD( Particle::Info, maxSize, F32, 1 ) } );
 
     Thruster::TYPE        = sdb.registerType( "Thruster", 64 );
-    Thruster::Info::STATE = sdb.registerState( Thruster::TYPE, "Info", sizeof( Thruster::Info ) );
+    Thruster::Info::STATE = sdb.registerState< Thruster::Info >( Thruster::TYPE, "Info" );
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -223,12 +227,20 @@ bool AppShipLanding::initialize( StateDb& sdb, Assets& assets )
     }
 
     const bool enableRocket = true;
-    for ( int meshIdx = 0; meshIdx < 150; ++meshIdx ) {
-        u64 meshHandle = 0;
-        auto mesh      = sdb.create< Renderer::Mesh::Info >( meshHandle );
+    const int meshCount     = 150;
+    Renderer::Mesh::Info meshPrototype;
+    meshPrototype.groups = Renderer::Group::DEFAULT;
+    std::vector< u64 > meshHandles( meshCount );
+    auto meshes = sdb.createBatch( meshCount, meshPrototype, &meshHandles[ 0 ] );
+    if ( !meshes ) {
+        Logger::debug( "ERROR: Out of memory creating %d meshes", meshCount );
+        return false;
+    }
+    for ( int meshIdx = 0; meshIdx < meshCount; ++meshIdx ) {
+        u64 meshHandle = meshHandles[ meshIdx ];
+        auto mesh      = meshes + meshIdx;
         mesh->translation =
             glm::linearRand( glm::fvec3( -15.0f, -15.0f, +20.0f ), glm::fvec3( +15.0f, +15.0f, +40.0f ) );
-        mesh->groups = Renderer::Group::DEFAULT;
 
         if ( enableRocket && meshIdx == 0 ) {
             mesh->translation = glm::fvec3( 0.0f, 0.0f, 10.0f );
@@ -240,6 +252,11 @@ bool AppShipLanding::initialize( StateDb& sdb, Assets& assets )
 
             m_rocketModelAsset = mesh->modelAsset;
 
+            m_rocketMeshHandle           = meshHandle;
+            auto rocketTransform         = sdb.create< Renderer::Transform::Info >( m_rocketTransformHandle );
+            rocketTransform->translation = mesh->translation;
+            rocketTransform->rotation    = mesh->rotation;
+
             // Create thrusters according to instances in model
             const Assets::Model* model = assets.refModel( mesh->modelAsset );
             for ( const Assets::Model::Instance& instance : model->instances ) {
@@ -255,13 +272,20 @@ bool AppShipLanding::initialize( StateDb& sdb, Assets& assets )
 
                 Math::decomposeTransform( xform, thruster->translation, thruster->rotation, thruster->scale );
 
-                auto debugMesh        = sdb.create< Renderer::Mesh::Info >( thruster->debugMeshHandle );
-                debugMesh->modelAsset = assets.asset( "Assets/Models/AxesXYZ.model" );
-                debugMesh->groups     = Renderer::Group::DEFAULT;
-
+                auto thrusterTransform = sdb.create< Renderer::Transform::Info >( thruster->transformHandle );
+                // Placement relative to rocket
+                thrusterTransform->parentTransformHandle = m_rocketTransformHandle;
+                thrusterTransform->translation           = thruster->translation;
+                thrusterTransform->rotation              = thruster->rotation;
+                // Debug mesh is only scaled to show mirrored thrusters
                 if ( thruster->scale.x < 0.0 || thruster->scale.y < 0.0 || thruster->scale.z < 0.0 ) {
-                    debugMesh->flags = Renderer::Mesh::Flag::SCALED;
+                    thrusterTransform->scale = thruster->scale;
                 }
+
+                auto debugMesh             = sdb.create< Renderer::Mesh::Info >( thruster->debugMeshHandle );
+                debugMesh->modelAsset      = assets.asset( "Assets/Models/AxesXYZ.model" );
+                debugMesh->groups          = Renderer::Group::DEFAULT;
+                debugMesh->transformHandle = thruster->transformHandle;
             }
 
             /*
@@ -303,16 +327,12 @@ void AppShipLanding::update( StateDb& sdb, Assets& assets, Renderer& renderer, d
 
     m_timeInS += deltaTimeInS;
 
-    // Update thruster debug meshes
-    {
-        auto thrusters = sdb.stateAll< Thruster::Info >();
-        for ( auto thruster : thrusters ) {
-            auto shipMesh          = sdb.state< Renderer::Mesh::Info >( thruster->shipMeshHandle );
-            auto debugMesh         = sdb.state< Renderer::Mesh::Info >( thruster->debugMeshHandle );
-            debugMesh->translation = shipMesh->translation + shipMesh->rotation * thruster->translation;
-            debugMesh->rotation    = shipMesh->rotation * thruster->rotation;
-            debugMesh->scale       = thruster->scale;
-        }
+    // Thruster debug meshes follow rocket through transform hierarchy
+    if ( m_rocketTransformHandle ) {
+        auto rocketMesh              = sdb.state< Renderer::Mesh::Info >( m_rocketMeshHandle );
+        auto rocketTransform         = sdb.stateMut< Renderer::Transform::Info >( m_rocketTransformHandle );
+        rocketTransform->translation = rocketMesh->translation;
+        rocketTransform->rotation    = rocketMesh->rotation;
     }
 
     // Update tileable dynamic ocean model
@@ -320,22 +340,24 @@ void AppShipLanding::update( StateDb& sdb, Assets& assets, Renderer& renderer, d
         PROFILER_SECTION( UpdateOcean, glm::fvec3( 0.0f, 1.0f, 1.0f ) )
 
         Assets::Model* model = assets.refModel( m_oceanModelAsset );
-        int vertexCount      = int( model->positions.size() );
-        for ( int vertexIdx = 0; vertexIdx < vertexCount; ++vertexIdx ) {
-            glm::fvec3& position = model->positions[ vertexIdx ];
-            glm::fvec2 pos2      = position.xy();
-            position.z           = oceanEquation( pos2, m_timeInS );
-            glm::fvec3 oceanPtLeft( pos2 + glm::fvec2( -1.0f, 0.0f ), 0.0f );
-            oceanPtLeft.z = oceanEquation( oceanPtLeft.xy(), m_timeInS );
-            glm::fvec3 oceanPtRight( pos2 + glm::fvec2( +1.0f, 0.0f ), 0.0f );
-            oceanPtRight.z = oceanEquation( oceanPtRight.xy(), m_timeInS );
-            glm::fvec3 oceanPtAbove( pos2 + glm::fvec2( 0.0f, +1.0f ), 0.0f );
-            oceanPtAbove.z = oceanEquation( oceanPtAbove.xy(), m_timeInS );
-            glm::fvec3 oceanPtBelow( pos2 + glm::fvec2( 0.0f, -1.0f ), 0.0f );
-            oceanPtBelow.z = oceanEquation( oceanPtBelow.xy(), m_timeInS );
-            model->normals[ vertexIdx ] =
-                glm::normalize( glm::cross( oceanPtRight - oceanPtLeft, oceanPtAbove - oceanPtBelow ) );
-        }
+        u64 vertexCount      = model->positions.size();
+        sdb.parallelFor( vertexCount, 256, [&]( u64 first, u64 count ) {
+            for ( u64 vertexIdx = first; vertexIdx < first + count; ++vertexIdx ) {
+                glm::fvec3& position = model->positions[ vertexIdx ];
+                glm::fvec2 pos2      = position.xy();
+                position.z           = oceanEquation( pos2, m_timeInS );
+                glm::fvec3 oceanPtLeft( pos2 + glm::fvec2( -1.0f, 0.0f ), 0.0f );
+                oceanPtLeft.z = oceanEquation( oceanPtLeft.xy(), m_timeInS );
+                glm::fvec3 oceanPtRight( pos2 + glm::fvec2( +1.0f, 0.0f ), 0.0f );
+                oceanPtRight.z = oceanEquation( oceanPtRight.xy(), m_timeInS );
+                glm::fvec3 oceanPtAbove( pos2 + glm::fvec2( 0.0f, +1.0f ), 0.0f );
+                oceanPtAbove.z = oceanEquation( oceanPtAbove.xy(), m_timeInS );
+                glm::fvec3 oceanPtBelow( pos2 + glm::fvec2( 0.0f, -1.0f ), 0.0f );
+                oceanPtBelow.z = oceanEquation( oceanPtBelow.xy(), m_timeInS );
+                model->normals[ vertexIdx ] =
+                    glm::normalize( glm::cross( oceanPtRight - oceanPtLeft, oceanPtAbove - oceanPtBelow ) );
+            }
+        } );
     }
 
     // FIXME(martinmo): Add keyboard input to platform abstraction (remove dependency to SDL)
@@ -465,7 +487,7 @@ void AppShipLanding::update( StateDb& sdb, Assets& assets, Renderer& renderer, d
         affector->force = thrustVector * mainEngineForce;
 
         // Use arrow mesh to display thrust vector
-        auto arrowMesh         = sdb.state< Renderer::Mesh::Info >( m_arrowMeshHandle );
+        auto arrowMesh         = sdb.stateMut< Renderer::Mesh::Info >( m_arrowMeshHandle );
         arrowMesh->translation = nozzlePosition;
         arrowMesh->rotation    = Math::rotateFromTo( glm::fvec3( 0.0f, 1.0f, 0.0f ), -affector->force );
 
@@ -516,58 +538,65 @@ void AppShipLanding::update( StateDb& sdb, Assets& assets, Renderer& renderer, d
     // Update rocket smoke particles
     {
         const float maxAgeInS = 2.0f;
-        std::vector< u64 > particleHandlesToBeDeleted;
-        auto particles = sdb.stateAll< Particle::Info >();
-        for ( auto particle : particles ) {
-            if ( particle->ageInS >= maxAgeInS ) {
-                particleHandlesToBeDeleted.push_back( sdb.handleFromState( particle ) );
-                continue;
-            }
+        auto particles        = sdb.stateAll< Particle::Info >();
+        u64 particleCount     = u64( particles.endElem - particles.beginElem );
+        m_particleMeshes.resize( particleCount );
+        sdb.resolve(
+            &particles.beginElem->meshHandle, particleCount, m_particleMeshes.data(),
+            sizeof( Particle::Info ) );
+
+        sdb.parallelFor< Particle::Info >( 64, [&]( StateDb::StateView< Particle::Info > chunk ) {
+            // Expired particles are retired once the loop is done (range has to stay stable)
+            StateDb::CommandBuffer commands( sdb );
+            Particle::Info* particle = chunk.data< Particle::Info >();
+            for ( u64 idx = 0; idx < chunk.size(); ++idx, ++particle ) {
+                if ( particle->ageInS >= maxAgeInS ) {
+                    commands.destroy( particle->meshHandle );
+                    commands.destroy( sdb.handleFromState( particle ) );
+                    continue;
+                }
 
-            auto mesh = sdb.state< Renderer::Mesh::Info >( particle->meshHandle );
-            if ( particle->ageInS > 0.0 ) {
-                mesh->translation += particle->velocity * float( deltaTimeInS );
-            }
-            particle->velocity += -particle->velocity * 1.0f * float( deltaTimeInS );
-            particle->ageInS += deltaTimeInS;
-
-            const float life   = glm::clamp( float( particle->ageInS ) / maxAgeInS, 0.0f, 1.0f );
-            const float grow   = 0.30f;
-            const float shrink = 0.25f;
-            float uniformScale = 1.0f;
-            if ( life >= 1.0f - shrink ) {
-                uniformScale = ( 1.0f - glm::smoothstep( 1.0f - shrink, 1.0f, life ) )
-                    * ( particle->maxSize - particle->minSize );
-                mesh->diffuseMul = glm::mix(
-                    glm::fvec4( 0.8, 0.8, 0.8, 1.0 ), glm::fvec4( 0.1, 0.1, 0.1, 1.0 ),
-                    ( life - ( 1.0f - shrink ) ) / shrink );
-            }
-            else if ( life <= grow ) {
-                uniformScale = particle->minSize
-                    + glm::smoothstep( 0.0f, grow, life ) * ( particle->maxSize - particle->minSize );
-                mesh->diffuseMul = glm::mix(
-                    glm::fvec4( 1.0, 0.5, 0.0, 1.0 ), glm::fvec4( 0.8, 0.8, 0.8, 1.0 ), life / grow );
-                mesh->ambientAdd = glm::mix(
-                    glm::fvec4( 1.0, 0.5, 0.0, 0.0 ), glm::fvec4( 0.0, 0.0, 0.0, 0.0 ), life / grow );
-            }
-            else {
-                uniformScale =
-                    particle->maxSize - glm::smoothstep( grow, 1.0f - shrink, life ) * particle->minSize;
-            }
-            mesh->scale = glm::fvec3( uniformScale );
+                auto mesh = m_particleMeshes[ particle - particles.beginElem ];
+                if ( particle->ageInS > 0.0 ) {
+                    mesh->translation += particle->velocity * float( deltaTimeInS );
+                }
+                particle->velocity += -particle->velocity * 1.0f * float( deltaTimeInS );
+                particle->ageInS += deltaTimeInS;
+
+                const float life   = glm::clamp( float( particle->ageInS ) / maxAgeInS, 0.0f, 1.0f );
+                const float grow   = 0.30f;
+                const float shrink = 0.25f;
+                float uniformScale = 1.0f;
+                if ( life >= 1.0f - shrink ) {
+                    uniformScale = ( 1.0f - glm::smoothstep( 1.0f - shrink, 1.0f, life ) )
+                        * ( particle->maxSize - particle->minSize );
+                    mesh->diffuseMul = glm::mix(
+                        glm::fvec4( 0.8, 0.8, 0.8, 1.0 ), glm::fvec4( 0.1, 0.1, 0.1, 1.0 ),
+                        ( life - ( 1.0f - shrink ) ) / shrink );
+                }
+                else if ( life <= grow ) {
+                    uniformScale = particle->minSize
+                        + glm::smoothstep( 0.0f, grow, life ) * ( particle->maxSize - particle->minSize );
+                    mesh->diffuseMul = glm::mix(
+                        glm::fvec4( 1.0, 0.5, 0.0, 1.0 ), glm::fvec4( 0.8, 0.8, 0.8, 1.0 ), life / grow );
+                    mesh->ambientAdd = glm::mix(
+                        glm::fvec4( 1.0, 0.5, 0.0, 0.0 ), glm::fvec4( 0.0, 0.0, 0.0, 0.0 ), life / grow );
+                }
+                else {
+                    uniformScale =
+                        particle->maxSize - glm::smoothstep( grow, 1.0f - shrink, life ) * particle->minSize;
+                }
+                mesh->scale = glm::fvec3( uniformScale );
 
-            float oceanHeight = oceanEquation( mesh->translation.xy(), m_timeInS );
-            float minHeight   = 0.3f * uniformScale + oceanHeight;
-            if ( mesh->translation.z < minHeight ) {
-                particle->velocity.z = 0.0f;
-                mesh->translation.z  = minHeight;
+                float oceanHeight = oceanEquation( mesh->translation.xy(), m_timeInS );
+                float minHeight   = 0.3f * uniformScale + oceanHeight;
+                if ( mesh->translation.z < minHeight ) {
+                    particle->velocity.z = 0.0f;
+                    mesh->translation.z  = minHeight;
+                }
+                sdb.markDirty( mesh );
             }
-        }
-        for ( auto& particleHandle : particleHandlesToBeDeleted ) {
-            auto particle = sdb.state< Particle::Info >( particleHandle );
-            sdb.destroy( particle->meshHandle );
-            sdb.destroy( particleHandle );
-        }
+        } );
     }
 
     // Update profiling UI
@@ -578,8 +607,8 @@ void AppShipLanding::update( StateDb& sdb, Assets& assets, Renderer& renderer, d
 
         uiModel->clear();
 
-        Profiler* profiling          = Profiler::instance();
-        Profiler::Thread* mainThread = profiling->mainThreadPrevFrame();
+        Profiler* profiling                = Profiler::instance();
+        const Profiler::Thread* mainThread = profiling->mainThreadPrevFrame();
 
         float offsPx   = 15.0f;
         float msPx     = 30.0f;
@@ -596,16 +625,16 @@ void AppShipLanding::update( StateDb& sdb, Assets& assets, Renderer& renderer, d
         glm::fvec3 red( 1.0f, 0.0f, 0.0f );
 
         if ( mainThread ) {
-            for ( Profiler::SectionSample& sample : mainThread->samples ) {
+            for ( const Profiler::SectionSample& sample : mainThread->samples ) {
                 float enterMs   = float( profiling->ticksToMs( sample.ticksEnter ) );
-                float exitMs    = float( profiling->ticksToMs( sample.ticksExit ) );
+                float exitMs    = float( profiling->ticksToMs( sample.ticksExit() ) );
                 float callDepth = float( sample.callDepth );
 
                 glm::fvec2 ll( offsPx + msPx * enterMs, offsPx + shrinkPx * callDepth );
                 glm::fvec2 ur( offsPx + msPx * exitMs, offsPx + barPx - shrinkPx * callDepth );
 
                 glm::fvec2 uro( ur + glm::fvec2( +outlPx, 0.0f ) );
-                glm::fvec3 color = sample.section->color;
+                glm::fvec3 color = profiling->section( sample.sectionId ).color;
 
                 pushRect2d( uiModel, ll, uro, color, callDepth );
                 pushRectOutline2d( uiModel, outlPx, ll, ur, black, callDepth + 0.5f );
@@ -669,9 +698,25 @@ void AppShipLanding::updateBuoyancyAffectors( StateDb& sdb, double timeInS )
     // FIXME(martinmo): ==> Cubes should have eight smaller affectors near corners
     // FIXME(martinmo): ==> Tori should have three/four small affectors inside tube
 
-    for ( auto buoyancyAffectorHandle : m_buoyancyAffectorHandles ) {
-        auto affector  = sdb.state< Physics::Affector::Info >( buoyancyAffectorHandle );
-        auto rigidBody = sdb.state< Physics::RigidBody::Info >( affector->rigidBodyHandle );
+    // Resolve affector => rigid body => mesh relations in batches (cached between frames)
+    const u64 affectorCount = m_buoyancyAffectorHandles.size();
+    auto affectors          = sdb.resolveCached(
+        m_buoyancyAffectors, m_buoyancyAffectorHandles.data(), affectorCount );
+    m_buoyancyRigidBodyHandles.resize( affectorCount );
+    for ( u64 affectorIdx = 0; affectorIdx < affectorCount; ++affectorIdx ) {
+        m_buoyancyRigidBodyHandles[ affectorIdx ] = affectors[ affectorIdx ]->rigidBodyHandle;
+    }
+    auto affectorRigidBodies =
+        sdb.resolveCached( m_buoyancyRigidBodies, m_buoyancyRigidBodyHandles.data(), affectorCount );
+    m_buoyancyMeshHandles.resize( affectorCount );
+    for ( u64 affectorIdx = 0; affectorIdx < affectorCount; ++affectorIdx ) {
+        m_buoyancyMeshHandles[ affectorIdx ] = affectorRigidBodies[ affectorIdx ]->meshHandle;
+    }
+    auto affectorMeshes = sdb.resolveCached( m_buoyancyMeshes, m_buoyancyMeshHandles.data(), affectorCount );
+
+    for ( u64 affectorIdx = 0; affectorIdx < affectorCount; ++affectorIdx ) {
+        auto affector  = affectors[ affectorIdx ];
+        auto rigidBody = affectorRigidBodies[ affectorIdx ];
 
         int rigidBodyIdx = int( rigidBody - rigidBodies.beginElem );
         ++affectorCountByRigidBody[ rigidBodyIdx ];
@@ -685,10 +730,10 @@ void AppShipLanding::updateBuoyancyAffectors( StateDb& sdb, double timeInS )
         rigidBody->linearVelocityLimit.z = 0.0;
     }
 
-    for ( auto buoyancyAffectorHandle : m_buoyancyAffectorHandles ) {
-        auto affector  = sdb.state< Physics::Affector::Info >( buoyancyAffectorHandle );
-        auto rigidBody = sdb.state< Physics::RigidBody::Info >( affector->rigidBodyHandle );
-        auto mesh      = sdb.state< Renderer::Mesh::Info >( rigidBody->meshHandle );
+    for ( u64 affectorIdx = 0; affectorIdx < affectorCount; ++affectorIdx ) {
+        auto affector  = affectors[ affectorIdx ];
+        auto rigidBody = affectorRigidBodies[ affectorIdx ];
+        auto mesh      = affectorMeshes[ affectorIdx ];
 
         int rigidBodyIdx           = int( rigidBody - rigidBodies.beginElem );
         int rigidBodyAffectorCount = affectorCountByRigidBody[ rigidBodyIdx ];
@@ -15,8 +15,9 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include "ModuleIf.hpp"
-
-struct Physics;
+#include "StateDb.hpp"
+#include "Physics.hpp"
+#include "Renderer.hpp"
 
 // -------------------------------------------------------------------------------------------------
 /// @brief Rocket science prototype logic module
@@ -64,6 +65,8 @@ private:
             glm::fquat rotation;
             glm::fvec3 scale;
             u64 debugMeshHandle = 0;
+            // Child of ship transform (debug mesh is placed relative to it)
+            u64 transformHandle = 0;
         };
     };
 
@@ -80,12 +83,24 @@ private:
     u32 m_postModelAsset   = 0;
     u32 m_rocketModelAsset = 0;
 
+    // Root of thruster transforms (follows rocket mesh)
+    u64 m_rocketMeshHandle      = 0;
+    u64 m_rocketTransformHandle = 0;
+
     std::list< u64 > m_sleepingMeshHandles;
-    std::list< u64 > m_buoyancyAffectorHandles;
+    std::vector< u64 > m_buoyancyAffectorHandles;
+
+    // Batch-resolved buoyancy affector => rigid body => mesh relations
+    StateDb::ResolveCache< Physics::Affector::Info > m_buoyancyAffectors;
+    std::vector< u64 > m_buoyancyRigidBodyHandles;
+    StateDb::ResolveCache< Physics::RigidBody::Info > m_buoyancyRigidBodies;
+    std::vector< u64 > m_buoyancyMeshHandles;
+    StateDb::ResolveCache< Renderer::Mesh::Info > m_buoyancyMeshes;
 
     double m_rocketSmokeParticlesDelay = 0.0;
 
     std::list< u64 > m_particles;
+    std::vector< Renderer::Mesh::Info* > m_particleMeshes;
 
     double m_timeInS = 0.0;
 
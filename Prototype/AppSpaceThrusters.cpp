@@ -126,6 +126,8 @@ void AppSpaceThrusters::imGuiUpdate( StateDb& sdb, Assets& assets )
     ImGui::Begin( "Thrusters" );
 
     if ( ImGui::Button( "Reset Space Ship" ) ) {
+        // Renderer has to see reset (physics leaves meshes of sleeping rigid bodies alone)
+        spaceShipMesh  = sdb.stateMut< Renderer::Mesh::Info >( m_spaceShipMeshHandle );
         *spaceShipMesh = m_spaceShipMeshInit;
         spaceShipRb->flags |= Physics::RigidBody::Flag::RESET_TO_MESH;
     }
@@ -212,7 +214,7 @@ void AppSpaceThrusters::imGuiUpdate( StateDb& sdb, Assets& assets )
     for ( auto& thruster : m_thrusters ) {
         ImGui::Button( thruster.name.c_str() );
 
-        auto infoMesh = sdb.state< Renderer::Mesh::Info >( thruster.infoMeshHandle );
+        auto infoMesh = sdb.stateMut< Renderer::Mesh::Info >( thruster.infoMeshHandle );
         auto affector = sdb.state< Physics::Affector::Info >( thruster.affectorHandle );
 
         // Default is for info mesh to be hidden and affector to be disabled
@@ -87,6 +87,12 @@ u32 Assets::touch( u32 hash )
     return ++infoIter->second.version;
 }
 
+// -------------------------------------------------------------------------------------------------
+const std::map< u32, Assets::Info >& Assets::infos() const
+{
+    return m_assetInfos;
+}
+
 // -------------------------------------------------------------------------------------------------
 Assets::Model* Assets::refModel( u32 hash )
 {
@@ -147,6 +147,9 @@ struct Assets
     const Info* info( u32 hash );
     u32 touch( u32 hash );
 
+    /// Registered assets by hash (assets are never unregistered)
+    const std::map< u32, Info >& infos() const;
+
     Model* refModel( u32 hash );
     Program* refProgram( u32 hash );
     Texture* refTexture( u32 hash );
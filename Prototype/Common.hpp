@@ -30,6 +30,13 @@ typedef signed long long int s64;
 #define COMMON_OSX
 #endif
 
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#define COMMON_PREFETCH( Address ) _mm_prefetch( (const char*)( Address ), _MM_HINT_T0 )
+#else
+#define COMMON_PREFETCH( Address ) __builtin_prefetch( Address )
+#endif
+
 #define COMMON_DISABLE_COPY( Class )                                                                         \
 private:                                                                                                     \
     Class( const Class& );                                                                                   \
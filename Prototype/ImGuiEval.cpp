@@ -5,6 +5,8 @@
 
 #include "ImGuiEval.hpp"
 
+#include <algorithm>
+
 #include <SDL.h>
 #include <imgui.h>
 
@@ -15,6 +17,43 @@
 #include "Renderer.hpp"
 #include "Profiler.hpp"
 
+// -------------------------------------------------------------------------------------------------
+static std::string fieldValueToString( const StateDb::Field& field, const void* value )
+{
+    std::string str;
+    const unsigned char* component = (const unsigned char*)value;
+    for ( u64 componentIdx = 0; componentIdx < field.count; ++componentIdx ) {
+        if ( componentIdx > 0 ) {
+            str += " ";
+        }
+        switch ( field.type ) {
+        case StateDb::Field::U32:
+            str += Str::build( "%lu", *(const u32*)component );
+            break;
+        case StateDb::Field::S32:
+            str += Str::build( "%ld", *(const s32*)component );
+            break;
+        case StateDb::Field::U64:
+            str += Str::build( "%llu", *(const u64*)component );
+            break;
+        case StateDb::Field::S64:
+            str += Str::build( "%lld", *(const s64*)component );
+            break;
+        case StateDb::Field::F32:
+            str += Str::build( "%.3f", *(const float*)component );
+            break;
+        case StateDb::Field::F64:
+            str += Str::build( "%.3f", *(const double*)component );
+            break;
+        case StateDb::Field::HANDLE:
+            str += Str::build( "0x%016llx", *(const u64*)component );
+            break;
+        }
+        component += field.sizeInB() / field.count;
+    }
+    return str;
+}
+
 // -------------------------------------------------------------------------------------------------
 ImGuiEval::ImGuiEval()
 {
@@ -113,15 +152,15 @@ void ImGuiEval::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
             ImGui::SetNextWindowSize( ImVec2( 200, 100 ), ImGuiCond_FirstUseEver );
             ImGui::Begin( "Profiler", &m_profilerVisible );
 
-            Profiler* profiling          = Profiler::instance();
-            Profiler::Thread* mainThread = profiling->mainThreadPrevFrame();
+            Profiler* profiling                = Profiler::instance();
+            const Profiler::Thread* mainThread = profiling->mainThreadPrevFrame();
 
             if ( mainThread ) {
                 int maxCallDepth  = -1;
                 int prevCallDepth = -1;
-                for ( Profiler::SectionSample& sample : mainThread->samples ) {
+                for ( const Profiler::SectionSample& sample : mainThread->samples ) {
                     float enterMs = float( profiling->ticksToMs( sample.ticksEnter ) );
-                    float exitMs  = float( profiling->ticksToMs( sample.ticksExit ) );
+                    float exitMs  = float( profiling->ticksToMs( sample.ticksExit() ) );
                     if ( maxCallDepth >= 0 ) {
                         if ( sample.callDepth > maxCallDepth ) {
                             continue;
@@ -134,13 +173,11 @@ void ImGuiEval::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
                     }
                     int flags = 0;
                     // TODO: Set 'ImGuiTreeNodeFlags_Leaf' if leaf node...
-                    if ( !ImGui::TreeNodeEx( sample.section->name.c_str(), flags ) ) {
+                    if ( !ImGui::TreeNodeEx( profiling->section( sample.sectionId ).name.c_str(), flags ) ) {
                         maxCallDepth = sample.callDepth;
                     }
                     ImGui::SameLine( 200 );
-                    ImGui::Text(
-                        "%8.0f us",
-                        Profiler::instance()->ticksToMs( sample.ticksExit - sample.ticksEnter ) * 1000.0f );
+                    ImGui::Text( "%8.0f us", profiling->ticksToMs( sample.ticksElapsed ) * 1000.0f );
                     if ( maxCallDepth >= 0 ) {
                         continue;
                     }
@@ -153,6 +190,9 @@ void ImGuiEval::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
 
             ImGui::End();
         }
+        if ( m_inspectorVisible ) {
+            updateInspector( sdb );
+        }
         for ( auto& module : m_modules )
             module->imGuiUpdate( sdb, assets );
         ImGui::Render();
@@ -180,7 +220,7 @@ void ImGuiEval::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
                 std::string assetName = Str::build( "Procedural/Models/ImGui_%03d", cmdListIdx );
                 mesh->modelAsset      = assets.asset( assetName, Assets::PROCEDURAL | Assets::DYNAMIC );
             }
-            auto mesh            = sdb.state< Renderer::Mesh::Info >( m_meshHandles[ cmdListIdx ] );
+            auto mesh            = sdb.stateMut< Renderer::Mesh::Info >( m_meshHandles[ cmdListIdx ] );
             Assets::Model* model = assets.refModel( mesh->modelAsset );
 
             if ( model->attrs.empty() ) {
@@ -224,3 +264,53 @@ void ImGuiEval::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
         }
     }
 }
+
+// -------------------------------------------------------------------------------------------------
+void ImGuiEval::updateInspector( StateDb& sdb )
+{
+    ImGui::SetNextWindowSize( ImVec2( 300, 200 ), ImGuiCond_FirstUseEver );
+    ImGui::SetNextWindowCollapsed( true, ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Inspector", &m_inspectorVisible );
+
+    m_inspectorObjectIdxs.resize( sdb.typeCount() + 1, 1 );
+    for ( u64 typeId = 1; typeId <= sdb.typeCount(); ++typeId ) {
+        std::string typeName = sdb.typeNameById( typeId );
+        int objectCount      = sdb.count( typeId );
+        if ( !ImGui::TreeNode( typeName.c_str(), "%s (%d)", typeName.c_str(), objectCount ) ) {
+            continue;
+        }
+        if ( objectCount == 0 ) {
+            ImGui::TreePop();
+            continue;
+        }
+
+        // Objects are browsed by index (handles are shown for reference)
+        int& objectIdx = m_inspectorObjectIdxs[ typeId ];
+        ImGui::SliderInt( "Object", &objectIdx, 1, objectCount );
+        objectIdx        = std::max( 1, std::min( objectIdx, objectCount ) );
+        u64 objectHandle = sdb.objectHandleByIdx( typeId, u64( objectIdx ) );
+        ImGui::Text( "Handle 0x%016llx", objectHandle );
+
+        for ( u64 stateId : sdb.typeStateIds( typeId ) ) {
+            std::string stateName                = sdb.stateNameById( stateId );
+            std::vector< StateDb::Field > fields = sdb.stateFields( stateId );
+            if ( fields.empty() ) {
+                ImGui::BulletText( "%s (no fields registered)", stateName.c_str() );
+                continue;
+            }
+            if ( !ImGui::TreeNode( stateName.c_str() ) ) {
+                continue;
+            }
+            for ( u64 fieldIdx = 0; fieldIdx < fields.size(); ++fieldIdx ) {
+                const void* value = sdb.fieldValue( stateId, fieldIdx, objectHandle );
+                ImGui::Text( "%s", fields[ fieldIdx ].name.c_str() );
+                ImGui::SameLine( 120 );
+                ImGui::Text( "%s", fieldValueToString( fields[ fieldIdx ], value ).c_str() );
+            }
+            ImGui::TreePop();
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::End();
+}
@@ -39,11 +39,18 @@ private:
     u64 m_programHandle     = 0;
     u64 m_passHandle        = 0;
 
-    bool m_metricsVisible  = true;
-    bool m_profilerVisible = true;
+    bool m_metricsVisible   = true;
+    bool m_profilerVisible  = true;
+    bool m_inspectorVisible = true;
+
+    // Index of object shown by inspector (by type ID)
+    std::vector< int > m_inspectorObjectIdxs;
 
     std::vector< ModuleIf* > m_modules;
 
+    /// Generic state database browser (based on field descriptors of states)
+    void updateInspector( StateDb& sdb );
+
 private:
     COMMON_DISABLE_COPY( ImGuiEval )
 };
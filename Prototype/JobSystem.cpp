@@ -0,0 +1,157 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+#include "Logger.hpp"
+
+// -------------------------------------------------------------------------------------------------
+JobSystem::JobSystem( u64 workerCount )
+    : m_queuedJobCount( 0 )
+    , m_running( true )
+{
+    if ( !workerCount ) {
+        u64 hardwareConcurrency = u64( std::thread::hardware_concurrency() );
+        workerCount             = hardwareConcurrency > 1 ? hardwareConcurrency - 1 : 0;
+    }
+
+    for ( u64 workerIdx = 0; workerIdx < workerCount; ++workerIdx ) {
+        m_workers.push_back( std::make_shared< Worker >() );
+    }
+    // Start threads only after all queues exist as workers steal from each other right away
+    for ( u64 workerIdx = 0; workerIdx < workerCount; ++workerIdx ) {
+        m_workers[ workerIdx ]->thread = std::thread( &JobSystem::workerMain, this, workerIdx );
+    }
+
+    Logger::debug( "Job system running %d worker threads", int( workerCount ) );
+}
+
+// -------------------------------------------------------------------------------------------------
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard< std::mutex > lock( m_wakeMutex );
+        m_running = false;
+    }
+    m_wakeCondition.notify_all();
+    for ( auto& worker : m_workers ) {
+        worker->thread.join();
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 JobSystem::workerCount() const
+{
+    return m_workers.size();
+}
+
+// -------------------------------------------------------------------------------------------------
+void JobSystem::parallelFor( u64 count, u64 grain, const RangeFunc& func )
+{
+    if ( !count ) {
+        return;
+    }
+
+    // A few chunks per thread to balance load (stealing takes care of the rest)
+    u64 threadCount = m_workers.size() + 1;
+    u64 chunkSize   = ( count + 4 * threadCount - 1 ) / ( 4 * threadCount );
+    if ( chunkSize < grain ) {
+        chunkSize = grain;
+    }
+    if ( chunkSize < 1 ) {
+        chunkSize = 1;
+    }
+    u64 chunkCount = ( count + chunkSize - 1 ) / chunkSize;
+
+    if ( m_workers.empty() || chunkCount == 1 ) {
+        func( 0, count );
+        return;
+    }
+
+    // Counted before pushing as workers might pop (and uncount) jobs right away
+    {
+        std::lock_guard< std::mutex > lock( m_wakeMutex );
+        m_queuedJobCount += chunkCount;
+    }
+    std::atomic< u64 > pendingCount( chunkCount );
+    for ( u64 chunkIdx = 0; chunkIdx < chunkCount; ++chunkIdx ) {
+        Job job;
+        job.func         = &func;
+        job.first        = chunkIdx * chunkSize;
+        job.count        = std::min( chunkSize, count - job.first );
+        job.pendingCount = &pendingCount;
+
+        Worker& worker = *m_workers[ chunkIdx % m_workers.size() ];
+        std::lock_guard< std::mutex > lock( worker.mutex );
+        worker.jobs.push_back( job );
+    }
+    m_wakeCondition.notify_all();
+
+    // Help out instead of waiting idle (might also execute jobs of other callers)
+    while ( pendingCount.load( std::memory_order_acquire ) > 0 ) {
+        Job job;
+        if ( popJob( m_workers.size(), job ) ) {
+            runJob( job );
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void JobSystem::workerMain( u64 workerIdx )
+{
+    while ( true ) {
+        Job job;
+        if ( popJob( workerIdx, job ) ) {
+            runJob( job );
+            continue;
+        }
+
+        std::unique_lock< std::mutex > lock( m_wakeMutex );
+        m_wakeCondition.wait( lock, [this]() { return !m_running || m_queuedJobCount > 0; } );
+        if ( !m_running ) {
+            return;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool JobSystem::popJob( u64 workerIdx, Job& job )
+{
+    // Own queue first (LIFO for locality of recently queued chunks)...
+    if ( workerIdx < m_workers.size() ) {
+        Worker& worker = *m_workers[ workerIdx ];
+        std::lock_guard< std::mutex > lock( worker.mutex );
+        if ( !worker.jobs.empty() ) {
+            job = worker.jobs.back();
+            worker.jobs.pop_back();
+            --m_queuedJobCount;
+            return true;
+        }
+    }
+    // ...then steal oldest job from other workers (FIFO)
+    for ( u64 offset = 1; offset <= m_workers.size(); ++offset ) {
+        Worker& victim = *m_workers[ ( workerIdx + offset ) % m_workers.size() ];
+        std::lock_guard< std::mutex > lock( victim.mutex );
+        if ( !victim.jobs.empty() ) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            --m_queuedJobCount;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+void JobSystem::runJob( const Job& job )
+{
+    ( *job.func )( job.first, job.count );
+    job.pendingCount->fetch_sub( 1, std::memory_order_release );
+}
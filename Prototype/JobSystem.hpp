@@ -0,0 +1,72 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include "Common.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------------------------------------
+/// @brief Work-stealing job system
+///
+/// Every worker thread owns a job queue. Workers take jobs from the back of their own queue and
+/// steal from the front of other workers' queues once their own queue runs dry. Threads waiting
+/// for their jobs to finish help executing jobs instead of blocking.
+struct JobSystem
+{
+    typedef std::function< void( u64 first, u64 count ) > RangeFunc;
+
+    /// Uses (hardware concurrency - 1) worker threads if 'workerCount' is 0
+    JobSystem( u64 workerCount = 0 );
+    virtual ~JobSystem();
+
+    /// Number of worker threads (not counting threads waiting for their jobs)
+    u64 workerCount() const;
+
+    /// Splits [0, count) into chunks of at least 'grain' elements, runs 'func' for all chunks
+    /// and returns once all chunks have been processed
+    void parallelFor( u64 count, u64 grain, const RangeFunc& func );
+
+private:
+    struct Job
+    {
+        const RangeFunc* func            = nullptr;
+        u64 first                        = 0;
+        u64 count                        = 0;
+        std::atomic< u64 >* pendingCount = nullptr;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque< Job > jobs;
+        std::thread thread;
+    };
+
+    std::vector< std::shared_ptr< Worker > > m_workers;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic< u64 > m_queuedJobCount;
+    std::atomic< bool > m_running;
+
+    void workerMain( u64 workerIdx );
+    bool popJob( u64 workerIdx, Job& job );
+    static void runJob( const Job& job );
+
+private:
+    COMMON_DISABLE_COPY( JobSystem )
+};
+
+#endif
@@ -7,12 +7,17 @@
 
 #include <memory>
 #include <cstdlib>
+#include <chrono>
+#include <string>
 
 #include <SDL.h>
 
 #include "Logger.hpp"
 
+#include "JobSystem.hpp"
 #include "StateDb.hpp"
+#include "StateDbRecording.hpp"
+#include "StateDbMirror.hpp"
 #include "Assets.hpp"
 
 #include "Renderer.hpp"
@@ -24,11 +29,108 @@
 
 #include "Profiler.hpp"
 
+// -------------------------------------------------------------------------------------------------
+/// Replays recording headless (no window/GL context) as fast as possible
+///
+/// Physics and renderer (without any GL work) are updated every replayed frame like when running
+/// interactively. Application and ImGui modules only define schema (the recording stands in for
+/// them).
+static int replay( const std::string& filename )
+{
+    Physics physics;
+    ImGuiEval imGuiEval;
+    Renderer renderer;
+    renderer.headless = true;
+
+    AppShipLanding app( physics );
+
+    JobSystem jobSystem;
+    StateDb sdb;
+    sdb.setJobSystem( &jobSystem );
+    Assets assets;
+
+    std::vector< ModuleIf* > modules = { &physics, &app, &imGuiEval, &renderer };
+    for ( auto& module : modules ) {
+        module->registerTypesAndStates( sdb );
+    }
+    // Headless renderer creates no objects ==> world of physics is the only object created by
+    // initialization and gets the same handle as when recording
+    std::vector< ModuleIf* > replayedModules = { &physics, &renderer };
+    for ( auto& module : replayedModules ) {
+        if ( !module->initialize( sdb, assets ) ) {
+            Logger::debug( "ERROR: Failed to initialize module" );
+            // FIXME(martinmo): Shutdown modules already initilized
+            return EXIT_FAILURE;
+        }
+    }
+
+    int result = EXIT_SUCCESS;
+    // Registers assets of recording (modules which registered them when recording are not run)
+    StateDbPlayer player( sdb, assets );
+    if ( player.open( filename ) ) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        while ( player.playFrame() ) {
+            // Active camera is chosen by application ==> first recorded camera stands in
+            auto cameras = sdb.stateAll< Renderer::Camera::Info >();
+            if ( !sdb.isHandleValid( renderer.activeCameraHandle ) && cameras.beginElem != cameras.endElem ) {
+                renderer.activeCameraHandle = sdb.handleFromState( cameras.beginElem );
+            }
+
+            double deltaTimeInS = 1.0 / 60.0;
+            for ( auto& module : replayedModules ) {
+                module->update( sdb, assets, renderer, deltaTimeInS );
+            }
+            sdb.flushDestroys();
+        }
+        double durationInS =
+            std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - startTime ).count();
+
+        Logger::debug(
+            "Replayed %d frames in %.3f s (%.1f frames/s)", int( player.frameCount() ), durationInS,
+            durationInS > 0.0 ? double( player.frameCount() ) / durationInS : 0.0 );
+    }
+    else {
+        Logger::debug( "ERROR: Failed to open recording \"%s\"", filename.c_str() );
+        result = EXIT_FAILURE;
+    }
+
+    std::reverse( replayedModules.begin(), replayedModules.end() );
+    for ( auto& module : replayedModules ) {
+        module->shutdown( sdb );
+    }
+
+    return result;
+}
+
 // -------------------------------------------------------------------------------------------------
 int main( int argc, char* argv[] )
 {
     Logger logging;
 
+    // '--record <file>' records state database per frame, '--replay <file>' replays it headless,
+    // '--mirror <name>' publishes state database into shared memory for 'Inspector' tool
+    std::string recordFilename;
+    std::string mirrorName;
+    for ( int argIdx = 1; argIdx < argc; ++argIdx ) {
+        std::string arg = argv[ argIdx ];
+        if ( arg != "--record" && arg != "--mirror" && arg != "--replay" ) {
+            continue;
+        }
+        if ( argIdx + 1 >= argc ) {
+            Logger::debug( "ERROR: Missing value of \"%s\"", arg.c_str() );
+            return EXIT_FAILURE;
+        }
+        if ( arg == "--record" ) {
+            recordFilename = argv[ ++argIdx ];
+        }
+        else if ( arg == "--mirror" ) {
+            mirrorName = argv[ ++argIdx ];
+        }
+        else {
+            return replay( argv[ argIdx + 1 ] );
+        }
+    }
+
     if ( SDL_Init( SDL_INIT_VIDEO ) ) {
         Logger::debug( "ERROR: Failed to initialize SDL" );
         return EXIT_FAILURE;
@@ -77,7 +179,10 @@ int main( int argc, char* argv[] )
         AppShipLanding app( physics );
         //AppSpaceThrusters app(physics, imGuiEval);
 
-        StateDb sdb;
+        JobSystem jobSystem;
+        // Arena has to be shared from the start as state memory is never moved
+        StateDb sdb( 0, 16ull * 1024 * 1024 * 1024, mirrorName.empty() ? "" : mirrorName + ".arena" );
+        sdb.setJobSystem( &jobSystem );
         Assets assets;
 
         std::vector< ModuleIf* > modules = { &physics, &app, &imGuiEval, &renderer };
@@ -96,6 +201,18 @@ int main( int argc, char* argv[] )
             }
         }
 
+        // Records objects created during initialization as part of first frame
+        StateDbRecorder recorder( sdb, assets );
+        if ( !recordFilename.empty() && !recorder.open( recordFilename ) ) {
+            Logger::debug( "ERROR: Failed to open recording \"%s\"", recordFilename.c_str() );
+            return EXIT_FAILURE;
+        }
+        StateDbMirror mirror( sdb );
+        if ( !mirrorName.empty() && !mirror.open( mirrorName ) ) {
+            Logger::debug( "ERROR: Failed to open mirror \"%s\"", mirrorName.c_str() );
+            return EXIT_FAILURE;
+        }
+
         bool running = true;
         SDL_Event event;
         while ( running ) {
@@ -107,10 +224,20 @@ int main( int argc, char* argv[] )
                 }
             }
 
+            // No-op if not mirroring
+            mirror.beginFrame();
+
             double deltaTimeInS = 1.0 / 60.0;
             for ( auto& module : modules ) {
                 module->update( sdb, assets, renderer, deltaTimeInS );
             }
+            sdb.flushDestroys();
+            // Hand over frame to snapshot readers (no-op as long as no state is selected)
+            sdb.publishSnapshot();
+            // No-op if not recording
+            recorder.recordFrame();
+            // No-op if not mirroring
+            mirror.publish();
 
             {
                 PROFILER_SECTION( ReloadAssets, glm::fvec3( 1.0f, 0.0f, 0.5f ) );
@@ -120,6 +247,12 @@ int main( int argc, char* argv[] )
             SDL_GL_SwapWindow( window );
         }
 
+        if ( !recordFilename.empty() ) {
+            Logger::debug(
+                "Recorded %d frames (%d kB)", int( recorder.frameCount() ),
+                int( recorder.recordedInB() / 1024 ) );
+        }
+
         for ( auto& module : modulesReversed ) {
             module->shutdown( sdb );
         }
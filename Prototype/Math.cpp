@@ -5,6 +5,13 @@
 
 #include "Math.hpp"
 
+#include <glm/glm.hpp>
+
+#if defined( _M_X64 ) || defined( __SSE2__ )
+#include <xmmintrin.h>
+#define MATH_SSE
+#endif
+
 const glm::fvec3 Math::X_AXIS = glm::fvec3( 1.0f, 0.0f, 0.0f );
 const glm::fvec3 Math::Y_AXIS = glm::fvec3( 0.0f, 1.0f, 0.0f );
 const glm::fvec3 Math::Z_AXIS = glm::fvec3( 0.0f, 0.0f, 1.0f );
@@ -59,3 +66,49 @@ void Math::decomposeTransform(
         scale.z = glm::length( xform3[ 2 ] ) * glm::dot( xform3[ 2 ], glm::fvec3( xform[ 2 ] ) );
     }
 }
+
+// -------------------------------------------------------------------------------------------------
+void Math::composeTransform(
+    const glm::fvec3& translation, const glm::fquat& rotation, const glm::fvec3& scale,
+    glm::fmat4& xform, glm::fmat4& xformInverse )
+{
+    glm::fmat3 rotation3 = glm::mat3_cast( rotation );
+
+    // T * R * S
+    xform[ 0 ] = glm::fvec4( rotation3[ 0 ] * scale.x, 0.0f );
+    xform[ 1 ] = glm::fvec4( rotation3[ 1 ] * scale.y, 0.0f );
+    xform[ 2 ] = glm::fvec4( rotation3[ 2 ] * scale.z, 0.0f );
+    xform[ 3 ] = glm::fvec4( translation, 1.0f );
+
+    // S^-1 * R^T * T^-1 (rows of rotation scaled by inverse scale)
+    glm::fmat3 inverse3 = glm::transpose( rotation3 );
+    inverse3[ 0 ] /= scale;
+    inverse3[ 1 ] /= scale;
+    inverse3[ 2 ] /= scale;
+    xformInverse[ 0 ] = glm::fvec4( inverse3[ 0 ], 0.0f );
+    xformInverse[ 1 ] = glm::fvec4( inverse3[ 1 ], 0.0f );
+    xformInverse[ 2 ] = glm::fvec4( inverse3[ 2 ], 0.0f );
+    xformInverse[ 3 ] = glm::fvec4( -( inverse3 * translation ), 1.0f );
+}
+
+// -------------------------------------------------------------------------------------------------
+void Math::mulMat4( const glm::fmat4& lhs, const glm::fmat4& rhs, glm::fmat4& result )
+{
+#ifdef MATH_SSE
+    // Columns of result are linear combinations of columns of 'lhs' (column-major storage)
+    __m128 lhs0 = _mm_loadu_ps( &lhs[ 0 ][ 0 ] );
+    __m128 lhs1 = _mm_loadu_ps( &lhs[ 1 ][ 0 ] );
+    __m128 lhs2 = _mm_loadu_ps( &lhs[ 2 ][ 0 ] );
+    __m128 lhs3 = _mm_loadu_ps( &lhs[ 3 ][ 0 ] );
+    for ( int col = 0; col < 4; ++col ) {
+        const float* rhsCol = &rhs[ col ][ 0 ];
+        __m128 sum          = _mm_mul_ps( lhs0, _mm_set1_ps( rhsCol[ 0 ] ) );
+        sum                 = _mm_add_ps( sum, _mm_mul_ps( lhs1, _mm_set1_ps( rhsCol[ 1 ] ) ) );
+        sum                 = _mm_add_ps( sum, _mm_mul_ps( lhs2, _mm_set1_ps( rhsCol[ 2 ] ) ) );
+        sum                 = _mm_add_ps( sum, _mm_mul_ps( lhs3, _mm_set1_ps( rhsCol[ 3 ] ) ) );
+        _mm_storeu_ps( &result[ col ][ 0 ], sum );
+    }
+#else
+    result = lhs * rhs;
+#endif
+}
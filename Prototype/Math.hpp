@@ -26,6 +26,14 @@ struct Math
     static void decomposeTransform(
         const glm::fmat4& xform, glm::fvec3& translation, glm::fquat& rotation, glm::vec3& scale );
 
+    /// Composes translation, rotation and (non-zero) scale into transform and its inverse
+    static void composeTransform(
+        const glm::fvec3& translation, const glm::fquat& rotation, const glm::fvec3& scale,
+        glm::fmat4& xform, glm::fmat4& xformInverse );
+
+    /// 'result = lhs * rhs' with SSE if available ('result' may alias either operand)
+    static void mulMat4( const glm::fmat4& lhs, const glm::fmat4& rhs, glm::fmat4& result );
+
 private:
     COMMON_DISABLE_COPY( Math )
 };
@@ -59,12 +59,17 @@ struct Physics::PrivateState
     std::map< u64, btCollisionShape* > collisionShapes;
     std::list< std::shared_ptr< btCollisionShape > > collisionShapesStorage;
 
-    std::list< std::shared_ptr< PrivateRigidBody > > privateRigidBodies;
-    std::list< std::shared_ptr< PrivateConstraint > > privateConstraints;
+    // Private data of live objects by handle (maintained through lifecycle journal of types)
+    std::map< u64, std::shared_ptr< PrivateRigidBody > > privateRigidBodies;
+    std::map< u64, std::shared_ptr< PrivateConstraint > > privateConstraints;
+    u64 rigidBodyLifecycleCursor  = 0;
+    u64 constraintLifecycleCursor = 0;
 
     StateDb& sdb;
     Assets& assets;
 
+    StateDb::ResolveCache< RigidBody::PrivateInfo > sensorRigidBodiesPrivate;
+
     static void preTickCallback( btDynamicsWorld* world, btScalar timeStep );
     static void postTickCallback( btDynamicsWorld* world, btScalar timeStep );
 
@@ -131,15 +136,34 @@ btQuaternion toBulletQuat( const glm::fquat& quat )
 Physics::PrivateRigidBody::PrivateRigidBody( PrivateState& stateInit, RigidBody::Info* rigidBody )
     : m_state( stateInit )
 {
+    // Mesh might not be set (yet) or destroyed in the same frame ==> placeholder mesh at origin
+    Renderer::Mesh::Info placeholderMesh;
+    Renderer::Mesh::Info* mesh = &placeholderMesh;
+    if ( m_state.sdb.isHandleValid( rigidBody->meshHandle ) ) {
+        mesh = m_state.sdb.stateMut< Renderer::Mesh::Info >( rigidBody->meshHandle );
+    }
+
     btCollisionShape* collisionShape = nullptr;
-    auto mesh                        = m_state.sdb.state< Renderer::Mesh::Info >( rigidBody->meshHandle );
     u64 collisionShapeKey            = u64( rigidBody->collisionShape ) << 32 | u64( mesh->modelAsset );
 
     // TODO(martinmo): Find way to get rid of map lookup
-    auto collisionShapeIter = m_state.collisionShapes.find( collisionShapeKey );
-    if ( collisionShapeIter == m_state.collisionShapes.end() ) {
-        const Assets::Model* model = m_state.assets.refModel( mesh->modelAsset );
-        COMMON_ASSERT( model != nullptr );
+    auto collisionShapeIter    = m_state.collisionShapes.find( collisionShapeKey );
+    const Assets::Model* model = nullptr;
+    if ( mesh != &placeholderMesh && collisionShapeIter == m_state.collisionShapes.end() ) {
+        model = m_state.assets.refModel( mesh->modelAsset );
+    }
+    if ( mesh == &placeholderMesh ) {
+        Logger::debug( "WARNING: Debug collision shape fallback (rigid body without mesh)" );
+        collisionShape = m_state.cubeShape.get();
+    }
+    else if (
+        collisionShapeIter == m_state.collisionShapes.end() && ( !model || model->positions.empty() ) ) {
+        // Unknown assets and procedural ones (not generated when replaying) have no vertices
+        // ==> not cached so that shape is derived from model once it has vertices
+        Logger::debug( "WARNING: Debug collision shape fallback (model without vertices)" );
+        collisionShape = m_state.cubeShape.get();
+    }
+    else if ( collisionShapeIter == m_state.collisionShapes.end() ) {
         glm::fvec3 min(
             std::numeric_limits< float >::max(), std::numeric_limits< float >::max(),
             std::numeric_limits< float >::max() );
@@ -304,8 +328,9 @@ Physics::PrivateState::PrivateState( StateDb& sdbInit, Assets& assetsInit )
 // -------------------------------------------------------------------------------------------------
 void Physics::PrivateState::preTick( btScalar timeStep )
 {
-    for ( const std::shared_ptr< PrivateRigidBody >& privateRigidBody : privateRigidBodies ) {
-        btRigidBody* bulletRigidBody = privateRigidBody->bulletRigidBody.get();
+    for ( const auto& privateRigidBodyEntry : privateRigidBodies ) {
+        PrivateRigidBody* privateRigidBody = privateRigidBodyEntry.second.get();
+        btRigidBody* bulletRigidBody       = privateRigidBody->bulletRigidBody.get();
         bulletRigidBody->clearForces();
         bulletRigidBody->applyGravity();
 
@@ -321,11 +346,15 @@ void Physics::PrivateState::preTick( btScalar timeStep )
 // -------------------------------------------------------------------------------------------------
 void Physics::PrivateState::postTick( btScalar timeStep )
 {
-    auto sensors = sdb.stateAll< Sensor::Info >();
+    auto sensors          = sdb.stateAll< Sensor::Info >();
+    u64 sensorCount       = u64( sensors.endElem - sensors.beginElem );
+    auto sensorsRbPrivate = sdb.resolveCached(
+        sensorRigidBodiesPrivate, &sensors.beginElem->simRbHandle, sensorCount, sizeof( Sensor::Info ) );
 
     // Update rigid body sensors
     for ( auto sensor : sensors ) {
-        auto rigidBodyPrivate = sdb.state< RigidBody::PrivateInfo >( sensor->simRbHandle );
+        auto rigidBodyPrivate = sensorsRbPrivate[ sensor - sensors.beginElem ];
+        COMMON_ASSERT( rigidBodyPrivate );
 
         // FIXME(MARTINMO): Avoid pointer chase by introducing state holding raw pointer
         // FIXME(MARTINMO): => Maybe just add copy of pointer in 'RigidBody::PrivateInfo'
@@ -361,12 +390,10 @@ void Physics::PrivateState::postTick( btScalar timeStep )
         }
     }
 
-    auto rigidBodies        = sdb.stateAll< RigidBody::Info >();
-    auto rigidBodiesPrivate = sdb.stateAll< RigidBody::PrivateInfo >();
-
     // Apply linear velocity limits to all RBs
-    for ( auto rigidBody : rigidBodies ) {
-        auto rigidBodyPrivate        = rigidBodiesPrivate.rel( rigidBodies, rigidBody );
+    for ( auto rigidBodyElems : sdb.view< RigidBody::Info, RigidBody::PrivateInfo >() ) {
+        auto rigidBody               = std::get< 0 >( rigidBodyElems );
+        auto rigidBodyPrivate        = std::get< 1 >( rigidBodyElems );
         btRigidBody* bulletRigidBody = rigidBodyPrivate->state->bulletRigidBody.get();
         btVector3 linearVelocity     = bulletRigidBody->getLinearVelocity();
         glm::fvec3 limit             = rigidBody->linearVelocityLimit;
@@ -406,23 +433,45 @@ u64 Physics::worldHandle() const
 void Physics::registerTypesAndStates( StateDb& sdb )
 {
     World::TYPE        = sdb.registerType( "World", 4096 );
-    World::Info::STATE = sdb.registerState( World::TYPE, "Info", sizeof( World::Info ) );
-
-    RigidBody::TYPE        = sdb.registerType( "RigidBody", 4096 );
-    RigidBody::Info::STATE = sdb.registerState( RigidBody::TYPE, "Info", sizeof( RigidBody::Info ) );
+    World::Info::STATE = sdb.registerState< World::Info >( World::TYPE, "Info" );
+
+    RigidBody::TYPE        = sdb.registerType( "RigidBody", 65536, StateDb::GROWABLE, 512 );
+    RigidBody::Info::STATE = sdb.registerState< RigidBody::Info >(
+        RigidBody::TYPE, "Info", 0,
+        { STATEDB_FIELD( RigidBody::Info, flags, U32, 1 ),
+          STATEDB_FIELD( RigidBody::Info, meshHandle, HANDLE, 1 ),
+          STATEDB_FIELD( RigidBody::Info, collisionShape, U32, 1 ),
+          STATEDB_FIELD( RigidBody::Info, collisionGroup, U32, 1 ),
+          STATEDB_FIELD( RigidBody::Info, collisionMask, U32, 1 ),
+          STATEDB_FIELD( RigidBody::Info, mass, F32, 1 ),
+          STATEDB_FIELD( RigidBody::Info, linearVelocity, F32, 3 ),
+          STATEDB_FIELD( RigidBody::Info, linearVelocityLimit, F32, 3 ),
+          STATEDB_FIELD( RigidBody::Info, angularVelocity, F32, 3 ) } );
     RigidBody::PrivateInfo::STATE =
-        sdb.registerState( RigidBody::TYPE, "PrivateInfo", sizeof( RigidBody::PrivateInfo ) );
+        sdb.registerState< RigidBody::PrivateInfo >( RigidBody::TYPE, "PrivateInfo", StateDb::TRANSIENT );
 
     Constraint::TYPE        = sdb.registerType( "Constraint", 512 );
-    Constraint::Info::STATE = sdb.registerState( Constraint::TYPE, "Info", sizeof( Constraint::Info ) );
+    Constraint::Info::STATE = sdb.registerState< Constraint::Info >( Constraint::TYPE, "Info" );
     Constraint::PrivateInfo::STATE =
-        sdb.registerState( Constraint::TYPE, "PrivateInfo", sizeof( Constraint::PrivateInfo ) );
+        sdb.registerState< Constraint::PrivateInfo >( Constraint::TYPE, "PrivateInfo", StateDb::TRANSIENT );
 
     Affector::TYPE        = sdb.registerType( "Affector", 512 );
-    Affector::Info::STATE = sdb.registerState( Affector::TYPE, "Info", sizeof( Affector::Info ) );
+    Affector::Info::STATE = sdb.registerState< Affector::Info >(
+        Affector::TYPE, "Info", 0,
+        { STATEDB_FIELD( Affector::Info, rigidBodyHandle, HANDLE, 1 ),
+          STATEDB_FIELD( Affector::Info, enabled, U32, 1 ),
+          STATEDB_FIELD( Affector::Info, forcePosition, F32, 3 ),
+          STATEDB_FIELD( Affector::Info, force, F32, 3 ), STATEDB_FIELD( Affector::Info, torque, F32, 3 ) } );
 
     Sensor::TYPE        = sdb.registerType( "Sensor", 512 );
-    Sensor::Info::STATE = sdb.registerState( Sensor::TYPE, "Info", sizeof( Sensor::Info ) );
+    Sensor::Info::STATE = sdb.registerState< Sensor::Info >(
+        Sensor::TYPE, "Info", 0,
+        { STATEDB_FIELD( Sensor::Info, type, S32, 1 ), STATEDB_FIELD( Sensor::Info, value, F32, 4 ),
+          STATEDB_FIELD( Sensor::Info, valueEx, F32, 4 ), STATEDB_FIELD( Sensor::Info, position, F32, 3 ),
+          STATEDB_FIELD( Sensor::Info, orientation, F32, 4 ),
+          STATEDB_FIELD( Sensor::Info, simRbHandle, HANDLE, 1 ),
+          STATEDB_FIELD( Sensor::Info, simBias, F32, 3 ), STATEDB_FIELD( Sensor::Info, simGain, F32, 3 ),
+          STATEDB_FIELD( Sensor::Info, simNoise, F32, 3 ) } );
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -430,6 +479,15 @@ bool Physics::initialize( StateDb& sdb, Assets& assets )
 {
     m_state = std::make_shared< PrivateState >( sdb, assets );
 
+    m_state->rigidBodyLifecycleCursor  = sdb.registerLifecycleCursor( RigidBody::TYPE );
+    m_state->constraintLifecycleCursor = sdb.registerLifecycleCursor( Constraint::TYPE );
+
+    // Rigid bodies, affectors and sensors do not outlive what they refer to beyond the frame of its
+    // destruction (relations are declared here as meshes are registered after us)
+    sdb.registerRelation( RigidBody::Info::STATE, "meshHandle", Renderer::Mesh::TYPE, StateDb::CASCADE );
+    sdb.registerRelation( Affector::Info::STATE, "rigidBodyHandle", RigidBody::TYPE, StateDb::CASCADE );
+    sdb.registerRelation( Sensor::Info::STATE, "simRbHandle", RigidBody::TYPE, StateDb::CASCADE );
+
     m_state->collisionConfiguration = std::make_shared< btDefaultCollisionConfiguration >();
     m_state->dispatcher = std::make_shared< btCollisionDispatcher >( m_state->collisionConfiguration.get() );
 
@@ -478,41 +536,34 @@ void Physics::shutdown( StateDb& sdb )
 
 // -------------------------------------------------------------------------------------------------
 template< class SrcType, class DstType, class UserData >
-void trackCreations( StateDb& sdb, std::list< std::shared_ptr< DstType > >& dstStorage, UserData& userData )
+void trackLifecycles(
+    StateDb& sdb, u64 cursorId, std::map< u64, std::shared_ptr< DstType > >& dstStorage, UserData& userData )
 {
-    auto srcRange        = sdb.stateAll< typename SrcType::Info >();
-    auto srcPrivateRange = sdb.stateAll< typename SrcType::PrivateInfo >();
-    for ( auto srcPrivate : srcPrivateRange ) {
-        if ( !srcPrivate->state ) {
-            auto src = srcRange.rel( srcPrivateRange, srcPrivate );
-            dstStorage.push_back( std::make_shared< DstType >( userData, src ) );
-            srcPrivate->state         = dstStorage.back().get();
-            srcPrivate->state->handle = sdb.handleFromState( src );
-            Logger::debug(
-                "Creation of \"%s\" (%d instances tracked)",
-                sdb.handleTypeName( srcPrivate->state->handle ).c_str(), int( dstStorage.size() ) );
+    // Only objects created/destroyed since last frame are visited
+    sdb.forEachLifecycleEvent( SrcType::TYPE, cursorId, [&]( const StateDb::LifecycleEvent& event ) {
+        if ( event.kind == StateDb::LifecycleEvent::DESTROYED ) {
+            // Objects created and destroyed again since last frame never got private data
+            if ( dstStorage.erase( event.objectHandle ) ) {
+                Logger::debug(
+                    "Destruction of \"%s\" (%d instances tracked)", sdb.typeNameById( SrcType::TYPE ).c_str(),
+                    int( dstStorage.size() ) );
+            }
+            return;
         }
-    }
-}
-
-// -------------------------------------------------------------------------------------------------
-template< class DstType >
-void trackDestructions( StateDb& sdb, std::list< std::shared_ptr< DstType > >& dstStorage )
-{
-    typename std::list< std::shared_ptr< DstType > >::iterator dstStorageIter;
-    std::vector< decltype( dstStorageIter ) > deletions;
-    for ( dstStorageIter = dstStorage.begin(); dstStorageIter != dstStorage.end(); ++dstStorageIter ) {
-        if ( !sdb.isHandleValid( dstStorageIter->get()->handle ) ) {
-            deletions.push_back( dstStorageIter );
+        if ( !sdb.isHandleValid( event.objectHandle ) ) {
+            return;
         }
-    }
-    while ( !deletions.empty() ) {
-        dstStorage.erase( deletions.back() );
-        deletions.pop_back();
+        auto src = sdb.state< typename SrcType::Info >( event.objectHandle );
+        auto dst = std::make_shared< DstType >( userData, src );
+
+        dst->handle                      = event.objectHandle;
+        dstStorage[ event.objectHandle ] = dst;
+        // Private state points at private data owned by storage
+        sdb.state< typename SrcType::PrivateInfo >( event.objectHandle )->state = dst.get();
         Logger::debug(
-            "Destruction of \"%s\" (%d instances tracked)",
-            sdb.handleTypeName( dstStorageIter->get()->handle ).c_str(), int( dstStorage.size() ) );
-    }
+            "Creation of \"%s\" (%d instances tracked)", sdb.handleTypeName( event.objectHandle ).c_str(),
+            int( dstStorage.size() ) );
+    } );
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -524,16 +575,17 @@ void Physics::update( StateDb& sdb, Assets& assets, Renderer& renderer, double d
     auto world = sdb.state< World::Info >( m_worldHandle );
     m_state->dynamicsWorld->setGravity( toBulletVec( world->gravity ) );
 
-    // Check for newly created rigid bodies
-    trackCreations< RigidBody >( sdb, m_state->privateRigidBodies, *m_state.get() );
-    // Check for newly created constraints
-    trackCreations< Constraint >( sdb, m_state->privateConstraints, *m_state.get() );
+    // Track created/destroyed rigid bodies
+    trackLifecycles< RigidBody >(
+        sdb, m_state->rigidBodyLifecycleCursor, m_state->privateRigidBodies, *m_state.get() );
+    // Track created/destroyed constraints (rigid bodies have to be around already)
+    trackLifecycles< Constraint >(
+        sdb, m_state->constraintLifecycleCursor, m_state->privateConstraints, *m_state.get() );
 
-    auto rigidBodies        = sdb.stateAll< RigidBody::Info >();
-    auto rigidBodiesPrivate = sdb.stateAll< RigidBody::PrivateInfo >();
+    auto rigidBodies = sdb.view< RigidBody::Info, RigidBody::PrivateInfo >();
 
     // Update rigid body affectors
-    for ( auto rigidBodyPrivate : rigidBodiesPrivate ) {
+    for ( auto rigidBodyPrivate : sdb.stateAll< RigidBody::PrivateInfo >() ) {
         rigidBodyPrivate->state->affectors.clear();
     }
     auto affectors = sdb.stateAll< Affector::Info >();
@@ -545,9 +597,9 @@ void Physics::update( StateDb& sdb, Assets& assets, Renderer& renderer, double d
     }
 
     // Handle mesh => rigid body state forwarding
-    for ( auto rigidBody : rigidBodies ) {
-        // TODO(martinmo): Delete rigid bodies with bad mesh references?
-        // TODO(martinmo): (e.g. mesh has been destroyed but rigid body still alive)
+    for ( auto rigidBodyElems : rigidBodies ) {
+        auto rigidBody = std::get< 0 >( rigidBodyElems );
+        // Mesh might not be set (yet) or destroyed since (relations cascade on flush only)
         if ( !sdb.isHandleValid( rigidBody->meshHandle ) ) {
             continue;
         }
@@ -556,7 +608,7 @@ void Physics::update( StateDb& sdb, Assets& assets, Renderer& renderer, double d
             continue;
         }
 
-        auto rigidBodyPrivate = rigidBodiesPrivate.rel( rigidBodies, rigidBody );
+        auto rigidBodyPrivate = std::get< 1 >( rigidBodyElems );
         auto mesh             = sdb.state< Renderer::Mesh::Info >( rigidBody->meshHandle );
 
         btRigidBody* bulletRigidBody = rigidBodyPrivate->state->bulletRigidBody.get();
@@ -565,6 +617,8 @@ void Physics::update( StateDb& sdb, Assets& assets, Renderer& renderer, double d
         bulletRigidBody->setAngularVelocity( btVector3( 0, 0, 0 ) );
         bulletRigidBody->setWorldTransform(
             btTransform( toBulletQuat( mesh->rotation ), toBulletVec( mesh->translation ) ) );
+        // Sleeping bodies would keep their meshes where they were before the reset
+        bulletRigidBody->activate( true );
 
         rigidBody->flags &= ~RigidBody::Flag::RESET_TO_MESH;
     }
@@ -597,28 +651,28 @@ void Physics::update( StateDb& sdb, Assets& assets, Renderer& renderer, double d
     */
 
     // Update mesh transforms according to rigid bodies
-    for ( auto rigidBody : rigidBodies ) {
-        // TODO(martinmo): Delete rigid bodies with bad mesh references?
-        // TODO(martinmo): (e.g. mesh has been destroyed but rigid body still alive)
+    for ( auto rigidBodyElems : rigidBodies ) {
+        auto rigidBody = std::get< 0 >( rigidBodyElems );
+        // Mesh might not be set (yet) or destroyed since (relations cascade on flush only)
         if ( !sdb.isHandleValid( rigidBody->meshHandle ) ) {
             continue;
         }
 
-        auto rigidBodyPrivate         = rigidBodiesPrivate.rel( rigidBodies, rigidBody );
+        auto rigidBodyPrivate         = std::get< 1 >( rigidBodyElems );
         btRigidBody* bulletRigidBody  = rigidBodyPrivate->state->bulletRigidBody.get();
         const btTransform& worldTrans = bulletRigidBody->getCenterOfMassTransform();
 
         rigidBody->linearVelocity  = fromBulletVec( bulletRigidBody->getLinearVelocity() );
         rigidBody->angularVelocity = fromBulletVec( bulletRigidBody->getAngularVelocity() );
 
-        auto mesh = sdb.state< Renderer::Mesh::Info >( rigidBody->meshHandle );
+        // Sleeping bodies do not move ==> leave their meshes (and derived renderer data) alone
+        if ( !bulletRigidBody->isActive() ) {
+            continue;
+        }
+
+        auto mesh = sdb.stateMut< Renderer::Mesh::Info >( rigidBody->meshHandle );
 
         mesh->translation = fromBulletVec( worldTrans.getOrigin() );
         mesh->rotation    = fromBulletQuat( worldTrans.getRotation() );
     }
-
-    // Check for destroyed rigid bodies
-    trackDestructions( sdb, m_state->privateRigidBodies );
-    // Check for destroyed constraints
-    trackDestructions( sdb, m_state->privateConstraints );
 }
@@ -5,9 +5,21 @@
 
 #include "Platform.hpp"
 
+#include <atomic>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifdef COMMON_WINDOWS
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 // -------------------------------------------------------------------------------------------------
 Platform::Platform()
 {
@@ -33,3 +45,273 @@ s64 Platform::fileModificationTime( const std::string& filename )
 #ifdef COMMON_WINDOWS
 #undef stat
 #endif
+
+// -------------------------------------------------------------------------------------------------
+u64 Platform::memoryPageSize()
+{
+#ifdef COMMON_WINDOWS
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo( &systemInfo );
+    return u64( systemInfo.dwPageSize );
+#else
+    return u64( sysconf( _SC_PAGESIZE ) );
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+void* Platform::reserveMemory( u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    return VirtualAlloc( nullptr, SIZE_T( sizeInB ), MEM_RESERVE, PAGE_NOACCESS );
+#else
+    void* address = mmap( nullptr, sizeInB, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    return address == MAP_FAILED ? nullptr : address;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Platform::commitMemory( void* address, u64 sizeInB )
+{
+    // Committed memory is guaranteed to be zero-initialized on all platforms
+#ifdef COMMON_WINDOWS
+    return VirtualAlloc( address, SIZE_T( sizeInB ), MEM_COMMIT, PAGE_READWRITE ) != nullptr;
+#else
+    return mprotect( address, sizeInB, PROT_READ | PROT_WRITE ) == 0;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+void Platform::releaseMemory( void* address, u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    VirtualFree( address, 0, MEM_RELEASE );
+#else
+    munmap( address, sizeInB );
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 Platform::hugeMemoryPageSize()
+{
+#ifdef COMMON_WINDOWS
+    return u64( GetLargePageMinimum() );
+#elif defined( MADV_HUGEPAGE )
+    return 2ull * 1024 * 1024;
+#else
+    return 0;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Platform::adviseHugePages( void* address, u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    // FIXME(martinmo): Large pages on Windows need 'SeLockMemoryPrivilege' and have to be
+    // FIXME(martinmo): committed all at once ==> not compatible with commit on demand
+    return false;
+#elif defined( MADV_HUGEPAGE )
+    // Transparent huge pages are used for committed pages of this range if available
+    return madvise( address, sizeInB, MADV_HUGEPAGE ) == 0;
+#else
+    return false;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+const void* Platform::mapFile( const std::string& filename, u64& sizeInB )
+{
+    sizeInB = 0;
+#ifdef COMMON_WINDOWS
+    HANDLE file = CreateFileA(
+        filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+        nullptr );
+    if ( file == INVALID_HANDLE_VALUE ) {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 ) {
+        CloseHandle( file );
+        return nullptr;
+    }
+    HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    CloseHandle( file );
+    if ( !mapping ) {
+        return nullptr;
+    }
+    // View keeps mapping alive after closing handle
+    const void* address = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( mapping );
+    if ( address ) {
+        sizeInB = u64( fileSize.QuadPart );
+    }
+    return address;
+#else
+    int file = open( filename.c_str(), O_RDONLY );
+    if ( file < 0 ) {
+        return nullptr;
+    }
+    struct stat status;
+    if ( fstat( file, &status ) != 0 || status.st_size == 0 ) {
+        close( file );
+        return nullptr;
+    }
+    void* address = mmap( nullptr, size_t( status.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+    close( file );
+    if ( address == MAP_FAILED ) {
+        return nullptr;
+    }
+    sizeInB = u64( status.st_size );
+    return address;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+void Platform::unmapFile( const void* address, u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    UnmapViewOfFile( address );
+#else
+    munmap( const_cast< void* >( address ), sizeInB );
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+#ifndef COMMON_WINDOWS
+static std::string sharedMemoryPath( const std::string& name )
+{
+    // POSIX shared memory names have to start with exactly one slash
+    return name.empty() || name[ 0 ] != '/' ? "/" + name : name;
+}
+#endif
+
+// -------------------------------------------------------------------------------------------------
+void* Platform::createSharedMemory( const std::string& name, u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    // FIXME(martinmo): Implement through named 'SEC_RESERVE' file mapping
+    return nullptr;
+#else
+    std::string path = sharedMemoryPath( name );
+    int segment      = shm_open( path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600 );
+    if ( segment < 0 ) {
+        return nullptr;
+    }
+    // Segment is sparse ==> only touched pages take up memory
+    if ( ftruncate( segment, off_t( sizeInB ) ) != 0 ) {
+        close( segment );
+        shm_unlink( path.c_str() );
+        return nullptr;
+    }
+    void* address = mmap( nullptr, sizeInB, PROT_NONE, MAP_SHARED | MAP_NORESERVE, segment, 0 );
+    close( segment );
+    if ( address == MAP_FAILED ) {
+        shm_unlink( path.c_str() );
+        return nullptr;
+    }
+    return address;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+void Platform::destroySharedMemory( const std::string& name, void* address, u64 sizeInB )
+{
+#ifndef COMMON_WINDOWS
+    munmap( address, sizeInB );
+    shm_unlink( sharedMemoryPath( name ).c_str() );
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+const void* Platform::openSharedMemory( const std::string& name, u64& sizeInB )
+{
+    sizeInB = 0;
+#ifdef COMMON_WINDOWS
+    return nullptr;
+#else
+    int segment = shm_open( sharedMemoryPath( name ).c_str(), O_RDONLY, 0 );
+    if ( segment < 0 ) {
+        return nullptr;
+    }
+    struct stat status;
+    if ( fstat( segment, &status ) != 0 || status.st_size == 0 ) {
+        close( segment );
+        return nullptr;
+    }
+    void* address = mmap( nullptr, size_t( status.st_size ), PROT_READ, MAP_SHARED, segment, 0 );
+    close( segment );
+    if ( address == MAP_FAILED ) {
+        return nullptr;
+    }
+    sizeInB = u64( status.st_size );
+    return address;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 Platform::createMemoryFile( u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    // FIXME(martinmo): Implement through pagefile-backed file mapping and 'FILE_MAP_COPY' views
+    return 0;
+#else
+#ifdef __linux__
+    int file = memfd_create( "StateDbMemoryFile", MFD_CLOEXEC );
+#else
+    // Name is only needed until segment is opened
+    static std::atomic< u64 > fileCount( 0 );
+    std::string path = "/MemoryFile." + std::to_string( getpid() ) + "." + std::to_string( fileCount++ );
+    int file         = shm_open( path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+    if ( file >= 0 ) {
+        shm_unlink( path.c_str() );
+    }
+#endif
+    if ( file < 0 ) {
+        return 0;
+    }
+    if ( ftruncate( file, off_t( sizeInB ) ) != 0 ) {
+        close( file );
+        return 0;
+    }
+    // Handle 0 means failure
+    return u64( file ) + 1;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Platform::writeMemoryFile( u64 file, u64 offsetInB, const void* data, u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    return false;
+#else
+    const char* bytes = (const char*)data;
+    while ( sizeInB > 0 ) {
+        ssize_t written = pwrite( int( file - 1 ), bytes, size_t( sizeInB ), off_t( offsetInB ) );
+        if ( written <= 0 ) {
+            return false;
+        }
+        bytes += written;
+        offsetInB += u64( written );
+        sizeInB -= u64( written );
+    }
+    return true;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+void* Platform::mapMemoryFileCopyOnWrite( u64 file, u64 sizeInB )
+{
+#ifdef COMMON_WINDOWS
+    return nullptr;
+#else
+    void* address = mmap( nullptr, sizeInB, PROT_NONE, MAP_PRIVATE | MAP_NORESERVE, int( file - 1 ), 0 );
+    return address == MAP_FAILED ? nullptr : address;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+void Platform::closeMemoryFile( u64 file )
+{
+#ifndef COMMON_WINDOWS
+    close( int( file - 1 ) );
+#endif
+}
@@ -19,6 +19,36 @@ struct Platform
 
     static s64 fileModificationTime( const std::string& filename );
 
+    /// Virtual memory management (reserve address space once, commit pages on demand)
+    static u64 memoryPageSize();
+    static void* reserveMemory( u64 sizeInB );
+    static bool commitMemory( void* address, u64 sizeInB );
+    static void releaseMemory( void* address, u64 sizeInB );
+    /// Returns 0 if huge pages are not supported
+    static u64 hugeMemoryPageSize();
+    static bool adviseHugePages( void* address, u64 sizeInB );
+
+    /// Maps whole file read-only into memory (returns 'nullptr' on failure)
+    static const void* mapFile( const std::string& filename, u64& sizeInB );
+    static void unmapFile( const void* address, u64 sizeInB );
+
+    /// Creates named shared memory segment and maps it like 'reserveMemory()' (commit pages with
+    /// 'commitMemory()', returns 'nullptr' on failure)
+    static void* createSharedMemory( const std::string& name, u64 sizeInB );
+    /// Unmaps segment created by this process and removes its name
+    static void destroySharedMemory( const std::string& name, void* address, u64 sizeInB );
+    /// Maps whole segment created by another process read-only (release with 'unmapFile()')
+    static const void* openSharedMemory( const std::string& name, u64& sizeInB );
+
+    /// Creates anonymous sparse memory file (zero-initialized, returns 0 on failure, close with
+    /// 'closeMemoryFile()' once it is not mapped anymore)
+    static u64 createMemoryFile( u64 sizeInB );
+    static bool writeMemoryFile( u64 file, u64 offsetInB, const void* data, u64 sizeInB );
+    /// Maps whole memory file privately like 'reserveMemory()' (committed pages share memory with
+    /// the file until they are written, release with 'releaseMemory()', returns 'nullptr' on failure)
+    static void* mapMemoryFileCopyOnWrite( u64 file, u64 sizeInB );
+    static void closeMemoryFile( u64 file );
+
 public:
 private:
     COMMON_DISABLE_COPY( Platform )
@@ -5,13 +5,93 @@
 
 #include "Profiler.hpp"
 
+#include <algorithm>
+#include <thread>
+
 #include <SDL.h>
 
+#include "Logger.hpp"
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#define PROFILER_USE_RDTSC
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define PROFILER_USE_RDTSC
+#endif
+
+// -------------------------------------------------------------------------------------------------
+/// Samples of one thread (written by that thread only, read by 'frameReset()')
+///
+/// Works like a sequence lock: 'writeCount' is incremented before a slot is (re-)used so that the
+/// reader can drop samples overwritten while it copied them. Samples up to 'commitCount' are
+/// complete (published whenever the thread leaves its outermost section).
+///
+/// Buffers are released when their thread exits and taken over by the next new thread (counts keep
+/// running ==> samples not collected yet are reported for the new thread).
+struct Profiler::ThreadBuffer
+{
+    static const u64 SAMPLE_COUNT   = 4096;
+    static const u64 MAX_CALL_DEPTH = 64;
+
+    std::atomic< u64 > id;
+    std::atomic< bool > released;
+    std::atomic< u64 > writeCount;
+    std::atomic< u64 > commitCount;
+    // Only accessed by 'frameReset()'
+    u64 readCount = 0;
+
+    u64 callDepth = 0;
+    u64 sampleIdxStack[ MAX_CALL_DEPTH ];
+    SectionSample samples[ SAMPLE_COUNT ];
+
+    ThreadBuffer()
+        : id( 0 )
+        , released( false )
+        , writeCount( 0 )
+        , commitCount( 0 )
+    {
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+/// Releases buffer of thread when thread exits (buffers that did not fit into table are deleted)
+struct Profiler::ThreadBufferOwner
+{
+    ThreadBuffer* buffer = nullptr;
+    bool registered      = false;
+
+    ~ThreadBufferOwner()
+    {
+        if ( registered ) {
+            buffer->released.store( true, std::memory_order_release );
+        }
+        else {
+            delete buffer;
+        }
+    }
+};
+
 // -------------------------------------------------------------------------------------------------
 Profiler::Profiler()
+    : m_sectionCount( 0 )
+    , m_threadCount( 0 )
+    , m_threadBuffers( u64( std::thread::hardware_concurrency() ) + EXTRA_THREAD_COUNT )
+    , m_publishedFrameIdx( 0 )
 {
-    m_ticksPerS  = SDL_GetPerformanceFrequency();
-    m_ticksPerMs = double( m_ticksPerS ) / 1000.0;
+    for ( auto& threadBuffer : m_threadBuffers ) {
+        threadBuffer.store( nullptr, std::memory_order_relaxed );
+    }
+
+    m_calibrationTicks   = ticks();
+    m_calibrationCounter = SDL_GetPerformanceCounter();
+    m_ticksFrameStart    = m_calibrationTicks;
+#ifdef PROFILER_USE_RDTSC
+    // Assume 1 GHz until calibrated at the first frame
+    m_ticksPerMs = 1000000.0;
+#else
+    m_ticksPerMs = double( SDL_GetPerformanceFrequency() ) / 1000.0;
+#endif
 
 #ifdef PROFILER_ENABLE_REMOTERY
     rmt_CreateGlobalInstance( &m_remotery );
@@ -24,6 +104,10 @@ Profiler::~Profiler()
 #ifdef PROFILER_ENABLE_REMOTERY
     rmt_DestroyGlobalInstance( m_remotery );
 #endif
+
+    for ( auto& threadBuffer : m_threadBuffers ) {
+        delete threadBuffer.load( std::memory_order_acquire );
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -34,39 +118,76 @@ Profiler* Profiler::instance()
 }
 
 // -------------------------------------------------------------------------------------------------
-Profiler::Thread* Profiler::mainThreadPrevFrame()
+const Profiler::Frame* Profiler::prevFrame() const
 {
-    if ( m_threadsPrevFrame.empty() ) {
+    return &m_frames[ m_publishedFrameIdx.load( std::memory_order_acquire ) ];
+}
+
+// -------------------------------------------------------------------------------------------------
+const Profiler::Thread* Profiler::mainThreadPrevFrame() const
+{
+    const Frame* frame = prevFrame();
+    if ( frame->mainThreadIdx < 0 ) {
         return nullptr;
     }
-    return &m_threadsPrevFrame.begin()->second;
+    return &frame->threads[ u64( frame->mainThreadIdx ) ];
 }
 
 // -------------------------------------------------------------------------------------------------
 void Profiler::frameReset()
 {
-    /*
-    // FIXME(martinmo): Swap to make sure raw pointers into samples vectors still valid
-    m_threadsPrevFrame.swap(m_threads);
-    m_threads = m_threadsPrevFrame;
-    */
+    u64 ticksNow = ticks();
+
+    // Only 'frameReset()' writes frames ==> other frame is not published
+    u64 frameIdx        = 1 - m_publishedFrameIdx.load( std::memory_order_relaxed );
+    Frame& frame        = m_frames[ frameIdx ];
+    frame.ticksStart    = m_ticksFrameStart;
+    frame.mainThreadIdx = -1;
+
+    ThreadBuffer* mainThreadBuffer = threadBuffer();
+    COMMON_ASSERT( mainThreadBuffer->callDepth == 0 );
+
+    u64 threadCount =
+        std::min( m_threadCount.load( std::memory_order_acquire ), u64( m_threadBuffers.size() ) );
+    frame.threads.resize( threadCount );
+    for ( u64 threadIdx = 0; threadIdx < threadCount; ++threadIdx ) {
+        Thread& thread       = frame.threads[ threadIdx ];
+        ThreadBuffer* buffer = m_threadBuffers[ threadIdx ].load( std::memory_order_acquire );
+        if ( !buffer ) {
+            // Registration still in progress
+            thread.id = 0;
+            thread.samples.clear();
+            continue;
+        }
+        if ( buffer == mainThreadBuffer ) {
+            frame.mainThreadIdx = s64( threadIdx );
+        }
+        thread.id = buffer->id.load( std::memory_order_relaxed );
+        collectSamples( *buffer, frame.ticksStart, thread.samples );
+    }
+    m_publishedFrameIdx.store( frameIdx, std::memory_order_release );
 
-    m_threadsPrevFrame = m_threads;
-    for ( auto& threadMapIter : m_threads ) {
-        COMMON_ASSERT( threadMapIter.second.callDepth == 0 );
-        threadMapIter.second.samples.clear();
-        threadMapIter.second.samplesStack.clear();
+#ifdef PROFILER_USE_RDTSC
+    u64 counterTicks = SDL_GetPerformanceCounter() - m_calibrationCounter;
+    if ( counterTicks ) {
+        double elapsedMs = double( counterTicks ) * 1000.0 / double( SDL_GetPerformanceFrequency() );
+        m_ticksPerMs     = double( ticksNow - m_calibrationTicks ) / elapsedMs;
     }
-    m_ticksFrameStart = SDL_GetPerformanceCounter();
+#endif
+    m_ticksFrameStart = ticksNow;
+}
+
+// -------------------------------------------------------------------------------------------------
+const Profiler::Section& Profiler::section( u64 sectionId ) const
+{
+    COMMON_ASSERT( sectionId < m_sectionCount.load( std::memory_order_acquire ) );
+    return *m_sections[ sectionId ];
 }
 
 // -------------------------------------------------------------------------------------------------
 double Profiler::ticksToMs( u64 ticks ) const
 {
-    u64 seconds         = ticks / m_ticksPerS;
-    u64 ticksRemaining  = ticks % m_ticksPerS;
-    double milliseconds = double( seconds ) * 1000.0 + double( ticksRemaining ) / m_ticksPerMs;
-    return milliseconds;
+    return double( ticks ) / m_ticksPerMs;
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -84,53 +205,53 @@ Profiler::Section::Section( const std::string& nameInit, const glm::fvec3& color
     : name( nameInit )
     , color( colorInit )
 {
-    m_profiling         = Profiler::instance();
-    u64 currentThreadId = u64( SDL_ThreadID() );
-    m_thread            = &m_profiling->m_threads[ currentThreadId ];
-    if ( !m_thread->id ) {
-        COMMON_ASSERT( currentThreadId );
-        m_thread->id = currentThreadId;
-        m_thread->samples.reserve( Thread::MAX_SAMPLE_COUNT );
-    }
-    COMMON_ASSERT( m_thread->id == currentThreadId );
+    // Sections are function statics ==> constructed once even if first entered concurrently
+    // (samples referring to section are published after registration by recording thread)
+    m_profiling = Profiler::instance();
+    id          = m_profiling->m_sectionCount.fetch_add( 1, std::memory_order_relaxed );
+    COMMON_ASSERT( id < MAX_SECTION_COUNT );
+    m_profiling->m_sections[ id ] = this;
 }
 
 // -------------------------------------------------------------------------------------------------
 void Profiler::Section::enter()
 {
-    u64 ticksEnter = m_profiling->ticksSinceFrameStart();
+    ThreadBuffer* buffer = m_profiling->threadBuffer();
+    COMMON_ASSERT( buffer->callDepth < ThreadBuffer::MAX_CALL_DEPTH );
 
-    // We have to make sure that we are not re-allocating 'Thread::samples' because we
-    // are storing pointers into that vector in 'Thread::samplesStack' and 'SectionSample::parent'
-    COMMON_ASSERT( m_thread->samples.size() < Thread::MAX_SAMPLE_COUNT );
-    m_thread->samples.push_back( SectionSample() );
-    SectionSample* sample = &m_thread->samples.back();
+    u64 sampleIdx = buffer->writeCount.load( std::memory_order_relaxed );
+    buffer->writeCount.store( sampleIdx + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
 
-    sample->section    = this;
-    sample->callDepth  = m_thread->callDepth;
-    sample->ticksEnter = ticksEnter;
-    /*
-    if (!m_thread->samplesStack.empty())
-    {
-        sample->parent = m_thread->samplesStack.back();
-    }
-    */
+    SectionSample& sample = buffer->samples[ sampleIdx % ThreadBuffer::SAMPLE_COUNT ];
+    sample.sectionId      = u16( id );
+    sample.callDepth      = u16( buffer->callDepth );
+    sample.ticksElapsed   = 0;
 
-    ++m_thread->callDepth;
-    m_thread->samplesStack.push_back( sample );
+    buffer->sampleIdxStack[ buffer->callDepth++ ] = sampleIdx;
+    // Taken last to leave bookkeeping out of measured time
+    sample.ticksEnter = ticks();
 }
 
 // -------------------------------------------------------------------------------------------------
 void Profiler::Section::exit()
 {
-    SectionSample* sample = m_thread->samplesStack.back();
+    u64 ticksExit = ticks();
 
-    m_thread->samplesStack.pop_back();
-    --m_thread->callDepth;
+    ThreadBuffer* buffer = m_profiling->threadBuffer();
+    COMMON_ASSERT( buffer->callDepth > 0 );
 
-    COMMON_ASSERT( m_thread->callDepth == sample->callDepth );
-
-    sample->ticksExit = m_profiling->ticksSinceFrameStart();
+    u64 sampleIdx  = buffer->sampleIdxStack[ --buffer->callDepth ];
+    u64 writeCount = buffer->writeCount.load( std::memory_order_relaxed );
+    // Sample is lost if nested sections wrapped around the ring buffer
+    if ( writeCount - sampleIdx <= ThreadBuffer::SAMPLE_COUNT ) {
+        SectionSample& sample = buffer->samples[ sampleIdx % ThreadBuffer::SAMPLE_COUNT ];
+        COMMON_ASSERT( sample.sectionId == id && sample.callDepth == buffer->callDepth );
+        sample.ticksElapsed = u32( std::min( ticksExit - sample.ticksEnter, u64( 0xffffffff ) ) );
+    }
+    if ( buffer->callDepth == 0 ) {
+        buffer->commitCount.store( writeCount, std::memory_order_release );
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -147,8 +268,78 @@ Profiler::SectionGuard::~SectionGuard()
 }
 
 // -------------------------------------------------------------------------------------------------
-u64 Profiler::ticksSinceFrameStart() const
+u64 Profiler::ticks()
+{
+#ifdef PROFILER_USE_RDTSC
+    // Invariant time stamp counter (a few cycles compared to querying the OS)
+    return __rdtsc();
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+Profiler::ThreadBuffer* Profiler::threadBuffer()
 {
-    u64 ticksPassed = SDL_GetPerformanceCounter() - m_ticksFrameStart;
-    return ticksPassed;
+    static thread_local ThreadBufferOwner owner;
+    if ( owner.buffer ) {
+        return owner.buffer;
+    }
+
+    // Take over buffer of exited thread if any
+    u64 threadCount =
+        std::min( m_threadCount.load( std::memory_order_acquire ), u64( m_threadBuffers.size() ) );
+    for ( u64 threadIdx = 0; threadIdx < threadCount && !owner.buffer; ++threadIdx ) {
+        ThreadBuffer* buffer = m_threadBuffers[ threadIdx ].load( std::memory_order_acquire );
+        bool released        = true;
+        if ( buffer
+             && buffer->released.compare_exchange_strong( released, false, std::memory_order_acq_rel ) ) {
+            owner.buffer     = buffer;
+            owner.registered = true;
+        }
+    }
+    if ( !owner.buffer ) {
+        owner.buffer  = new ThreadBuffer;
+        u64 threadIdx = m_threadCount.fetch_add( 1, std::memory_order_relaxed );
+        if ( threadIdx < m_threadBuffers.size() ) {
+            m_threadBuffers[ threadIdx ].store( owner.buffer, std::memory_order_release );
+            owner.registered = true;
+        }
+        else {
+            Logger::debug( "WARNING: Too many threads to profile (samples of thread are dropped)" );
+        }
+    }
+    owner.buffer->id.store( u64( SDL_ThreadID() ), std::memory_order_relaxed );
+    return owner.buffer;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Profiler::collectSamples(
+    ThreadBuffer& buffer, u64 ticksFrameStart, std::vector< SectionSample >& samples )
+{
+    samples.clear();
+
+    // Samples older than one ring buffer are overwritten already
+    u64 commitCount = buffer.commitCount.load( std::memory_order_acquire );
+    u64 firstIdx    = buffer.readCount;
+    if ( commitCount - firstIdx > ThreadBuffer::SAMPLE_COUNT ) {
+        firstIdx = commitCount - ThreadBuffer::SAMPLE_COUNT;
+    }
+    for ( u64 sampleIdx = firstIdx; sampleIdx < commitCount; ++sampleIdx ) {
+        samples.push_back( buffer.samples[ sampleIdx % ThreadBuffer::SAMPLE_COUNT ] );
+    }
+    buffer.readCount = commitCount;
+
+    // Drop samples that were overwritten while copying them
+    std::atomic_thread_fence( std::memory_order_acquire );
+    u64 writeCount = buffer.writeCount.load( std::memory_order_relaxed );
+    if ( writeCount - firstIdx > ThreadBuffer::SAMPLE_COUNT ) {
+        u64 overwrittenCount =
+            std::min( writeCount - firstIdx - ThreadBuffer::SAMPLE_COUNT, u64( samples.size() ) );
+        samples.erase( samples.begin(), samples.begin() + overwrittenCount );
+    }
+
+    for ( SectionSample& sample : samples ) {
+        sample.ticksEnter = sample.ticksEnter > ticksFrameStart ? sample.ticksEnter - ticksFrameStart : 0;
+    }
 }
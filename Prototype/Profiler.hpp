@@ -8,9 +8,10 @@
 
 #include "Common.hpp"
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <map>
 
 #include <glm/glm.hpp>
 
@@ -30,27 +31,43 @@
 
 // -------------------------------------------------------------------------------------------------
 /// @brief Profiler module
+///
+/// Sections can be entered on any thread: every thread records into its own ring buffer without
+/// locks and 'frameReset()' (main thread) collects completed samples of all threads once per frame
+/// into a frame which is published by swapping it with the previously published one.
 struct Profiler
 {
     struct Section;
 
+    /// Plain record of one execution of a section (ticks relative to frame start once published)
     struct SectionSample
     {
-        u64 ticksEnter         = 0;
-        u64 ticksExit          = 0;
-        const Section* section = nullptr;
-        s32 callDepth          = 0;
+        u64 ticksEnter        = 0;
+        uint32_t ticksElapsed = 0;  // saturates (sections taking longer than 2^32 ticks)
+        u16 sectionId         = 0;
+        u16 callDepth         = 0;
+
+        u64 ticksExit() const
+        {
+            return ticksEnter + ticksElapsed;
+        }
     };
+    // 'u32' is 64 bit on LP64 platforms ==> fixed width type keeps four samples per cache line
+    static_assert( sizeof( SectionSample ) == 16, "Section samples are expected to take 16 B" );
 
+    /// Samples of one thread in order of entering sections
     struct Thread
     {
-        static const int MAX_SAMPLE_COUNT = 256;
-
-        u64 id           = 0;
-        std::string name = "unknown";
-        s32 callDepth    = 0;
+        u64 id = 0;
         std::vector< SectionSample > samples;
-        std::vector< SectionSample* > samplesStack;
+    };
+
+    /// Samples completed by all threads during one frame (threads in order of their first sample)
+    struct Frame
+    {
+        u64 ticksStart    = 0;
+        s64 mainThreadIdx = -1;
+        std::vector< Thread > threads;
     };
 
 public:
@@ -59,9 +76,12 @@ public:
 
     static Profiler* instance();
 
-    Thread* mainThreadPrevFrame();
+    /// Published frames stay valid until the next but one 'frameReset()'
+    const Frame* prevFrame() const;
+    const Thread* mainThreadPrevFrame() const;
     void frameReset();
 
+    const Section& section( u64 sectionId ) const;
     double ticksToMs( u64 ticks ) const;
 
 #ifdef PROFILER_ENABLE_BROFILER
@@ -75,12 +95,12 @@ public:
 
         std::string name = "unknown";
         glm::fvec3 color;
+        u64 id = 0;
 
         void enter();
         void exit();
 
     private:
-        Thread* m_thread      = nullptr;
         Profiler* m_profiling = nullptr;
     };
 
@@ -96,18 +116,37 @@ public:
     };
 
 private:
-    std::map< u64, Thread > m_threads;
-    std::map< u64, Thread > m_threadsPrevFrame;
+    static const u64 MAX_SECTION_COUNT = 1024;
+    // Threads profiled at the same time beyond one per hardware thread
+    static const u64 EXTRA_THREAD_COUNT = 32;
+
+    struct ThreadBuffer;
+    struct ThreadBufferOwner;
+
+    // Registered once (sections are static, thread buffers live as long as the profiler and are
+    // reused by new threads once their thread exited)
+    std::atomic< u64 > m_sectionCount;
+    Section* m_sections[ MAX_SECTION_COUNT ];
+    std::atomic< u64 > m_threadCount;
+    std::vector< std::atomic< ThreadBuffer* > > m_threadBuffers;
+
+    Frame m_frames[ 2 ];
+    std::atomic< u64 > m_publishedFrameIdx;
 
-    u64 m_ticksPerS       = 0;
-    double m_ticksPerMs   = 0.0;
     u64 m_ticksFrameStart = 0;
+    double m_ticksPerMs   = 0.0;
+
+    // Cycle counter ticks are calibrated against the performance counter
+    u64 m_calibrationTicks   = 0;
+    u64 m_calibrationCounter = 0;
 
 #ifdef PROFILER_ENABLE_REMOTERY
     Remotery* m_remotery = nullptr;
 #endif
 
-    u64 ticksSinceFrameStart() const;
+    static u64 ticks();
+    ThreadBuffer* threadBuffer();
+    void collectSamples( ThreadBuffer& buffer, u64 ticksFrameStart, std::vector< SectionSample >& samples );
 
 private:
     COMMON_DISABLE_COPY( Profiler )
@@ -40,6 +40,13 @@ unix {
     QMAKE_EXT_CPP = .cpp .c
     # Enable C++11 support
     QMAKE_CXXFLAGS += -std=c++11
+    # Job system worker threads
+    QMAKE_CXXFLAGS += -pthread
+    QMAKE_LFLAGS += -pthread
+}
+linux {
+    # 'shm_open()' on older glibc
+    LIBS += -lrt
 }
 macx {
     QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.13
@@ -177,6 +184,7 @@ HEADERS += \
     AppSpaceThrusters.hpp \
     Assets.hpp \
     ImGuiEval.hpp \
+    JobSystem.hpp \
     Physics.hpp \
     Platform.hpp \
     Profiler.hpp \
@@ -184,7 +192,10 @@ HEADERS += \
     Math.hpp \
     Parser.hpp \
     Renderer.hpp \
+    SpatialIndex.hpp \
     StateDb.hpp \
+    StateDbMirror.hpp \
+    StateDbRecording.hpp \
     Str.hpp
 
 SOURCES += \
@@ -192,6 +203,7 @@ SOURCES += \
     AppSpaceThrusters.cpp \
     Assets.cpp \
     ImGuiEval.cpp \
+    JobSystem.cpp \
     Physics.cpp \
     Platform.cpp \
     Profiler.cpp \
@@ -199,7 +211,10 @@ SOURCES += \
     Math.cpp \
     Parser.cpp \
     Renderer.cpp \
+    SpatialIndex.cpp \
     StateDb.cpp \
+    StateDbMirror.cpp \
+    StateDbRecording.cpp \
     Str.cpp
 
 OTHER_FILES += \
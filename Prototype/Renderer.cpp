@@ -15,7 +15,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Logger.hpp"
+#include "Math.hpp"
 #include "Profiler.hpp"
+#include "SpatialIndex.hpp"
 
 #include "StateDb.hpp"
 #include "Assets.hpp"
@@ -124,6 +126,28 @@ struct Renderer::PrivateState
     u64 emissionProgramHandle     = 0;
     u64 emissionPostProgramHandle = 0;
 
+    // Consumer of 'Mesh::Info' changes (transforms of unchanged meshes are kept)
+    u64 meshChangeConsumer = 0;
+    // Cursor into mesh lifecycle journal (private data of new meshes is set up once)
+    u64 meshLifecycleCursor = 0;
+
+    // Consumer of 'Transform::Info' changes and cursor into transform lifecycle journal (order of
+    // transforms is only rebuilt if hierarchy changed)
+    u64 transformChangeConsumer  = 0;
+    u64 transformLifecycleCursor = 0;
+    u64 transformPass            = 0;
+    std::vector< u64 > transformDepths;
+    std::vector< u64 > transformChain;
+
+    // Bounding spheres of meshes of world groups (updated for meshes moved since last frame only)
+    SpatialIndex meshIndex;
+    std::vector< u32 > movedMeshIdxs;
+    std::vector< u64 > movedMeshHandles;
+    std::vector< glm::fvec3 > movedMeshCenters;
+    std::vector< float > movedMeshRadii;
+    std::vector< u64 > visibleMeshHandles;
+    u64 visibleStamp = 0;
+
     std::map< u32, PrivateMesh > meshesByModelAsset;
     std::map< std::string, GLuint > attrIndicesByName;
 };
@@ -166,6 +190,10 @@ struct Renderer::PrivateMesh
     const Assets::Info* assetInfo = nullptr;
     u32 flags                     = 0;
 
+    // Bounding sphere of positions in model space (radius < 0 if model is not spatially indexed)
+    glm::fvec3 boundsCenter;
+    float boundsRadius = -1.0f;
+
     GLuint vao   = 0;
     GLenum usage = GL_STATIC_DRAW;
 
@@ -193,8 +221,6 @@ struct Renderer::Program::PrivateInfo
     GLuint fragmentShader = 0;
     GLuint program        = 0;
     // Uniforms
-    // FIXME(martinmo): State DB does not support non-0 initial values...
-    // FIXME(martinmo): ==> Value of -1 would be correct value (see below)
     GLint uModelToWorldMatrix = -1;
     GLint uModelToViewMatrix  = -1;
     GLint uProjectionMatrix   = -1;
@@ -216,8 +242,57 @@ struct Renderer::Mesh::PrivateInfo
     static u64 STATE;
     // Store 1:n relation between mesh data from model ('PrivateMesh') and mesh instance
     PrivateMesh* privateMesh = nullptr;
+    // Updated in 'update()' whenever 'Mesh::Info' (or world transform of its transform) changed
+    // (shared by all passes)
+    glm::fmat4 modelToWorld;
+    // 'Transform::World::version' 'modelToWorld' was computed from
+    u64 transformVersion = 0;
+    // Mesh is in 'PrivateState::meshIndex' (meshes not in index are never culled)
+    bool spatiallyIndexed = false;
+    // Equal to 'PrivateState::visibleStamp' if mesh is inside frustum of default pass
+    u64 visibleStamp = 0;
 };
 u64 Renderer::Mesh::PrivateInfo::STATE = 0;
+// Groups and visibility of meshes (derived from 'Mesh::Info' for 'StateDb::selectTagged()')
+struct Renderer::Mesh::PrivateTags
+{
+    static u64 STATE;
+    // Groups in low bits
+    static const u64 HIDDEN      = 1ull << 63;
+    static const u64 TRANSFORMED = 1ull << 62;  // placed relative to a transform
+    u64 bits                     = 0;
+};
+u64 Renderer::Mesh::PrivateTags::STATE = 0;
+const u64 Renderer::Mesh::PrivateTags::HIDDEN;
+const u64 Renderer::Mesh::PrivateTags::TRANSFORMED;
+
+// Groups rendered with world camera (only meshes of these groups are spatially indexed)
+static const u32 WORLD_GROUPS = Renderer::Group::DEFAULT | Renderer::Group::DEFAULT_TRANSPARENT;
+
+// -------------------------------------------------------------------------------------------------
+static glm::fmat4 meshModelToParent( const Renderer::Mesh::Info& mesh )
+{
+    glm::fmat4 translation   = glm::translate( glm::fmat4( 1.0f ), mesh.translation );
+    glm::fmat4 modelToParent = translation * glm::mat4_cast( mesh.rotation );
+    if ( mesh.flags & Renderer::Mesh::Flag::SCALED ) {
+        modelToParent *= glm::scale( glm::fmat4( 1.0f ), mesh.scale );
+    }
+    return modelToParent;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Projection and world-to-view transform of passes rendered with world camera
+static void worldCameraTransforms(
+    StateDb& sdb, u64 cameraHandle, glm::fmat4& projection, glm::fmat4& worldToView )
+{
+    const float aspect = 16.0f / 9.0f;
+    projection         = glm::perspective( glm::radians( 30.0f * aspect ), aspect, 0.5f, 200.0f );
+    worldToView        = glm::fmat4( 1.0f );
+    if ( cameraHandle ) {
+        auto camera = sdb.state< Renderer::Camera::Info >( cameraHandle );
+        worldToView = glm::lookAt( camera->position, camera->target, glm::fvec3( 0.0f, 0.0f, 1.0f ) );
+    }
+}
 
 // -------------------------------------------------------------------------------------------------
 u64 Renderer::Texture::TYPE        = 0;
@@ -240,11 +315,21 @@ u64 Renderer::Pass::Info::STATE = 0;
 u64 Renderer::Camera::TYPE        = 0;
 u64 Renderer::Camera::Info::STATE = 0;
 
-/*
 // -------------------------------------------------------------------------------------------------
-u64 Renderer::Transform::TYPE = 0;
-u64 Renderer::Transform::Info::STATE = 0;
-*/
+u64 Renderer::Transform::TYPE         = 0;
+u64 Renderer::Transform::Info::STATE  = 0;
+u64 Renderer::Transform::World::STATE = 0;
+struct Renderer::Transform::PrivateInfo
+{
+    static u64 STATE;
+    // Parent as of last hierarchy update (hierarchy is updated if 'Info' differs)
+    u64 parentTransformHandle = 0;
+    u64 parentIdx             = 0;
+    u64 depth                 = 0;
+    // World transform is recomputed in pass 'PrivateState::transformPass' if equal
+    u64 dirtyPass = 0;
+};
+u64 Renderer::Transform::PrivateInfo::STATE = 0;
 
 // -------------------------------------------------------------------------------------------------
 Renderer::PrivateHelpers::PrivateHelpers( PrivateFuncs* funcs )
@@ -352,31 +437,46 @@ Renderer::~Renderer()
 // -------------------------------------------------------------------------------------------------
 void Renderer::registerTypesAndStates( StateDb& sdb )
 {
-    Program::TYPE        = sdb.registerType( "Program", 16 );
-    Program::Info::STATE = sdb.registerState( Program::TYPE, "Info", sizeof( Program::Info ) );
+    Program::TYPE               = sdb.registerType( "Program", 16 );
+    Program::Info::STATE        = sdb.registerState< Program::Info >( Program::TYPE, "Info" );
     Program::PrivateInfo::STATE =
-        sdb.registerState( Program::TYPE, "PrivateInfo", sizeof( Program::PrivateInfo ) );
-
-    Mesh::TYPE               = sdb.registerType( "Mesh", 4096 );
-    Mesh::Info::STATE        = sdb.registerState( Mesh::TYPE, "Info", sizeof( Mesh::Info ) );
-    Mesh::PrivateInfo::STATE = sdb.registerState( Mesh::TYPE, "PrivateInfo", sizeof( Mesh::PrivateInfo ) );
-
-    Texture::TYPE        = sdb.registerType( "Texture", 256 );
-    Texture::Info::STATE = sdb.registerState( Texture::TYPE, "Info", sizeof( Texture::Info ) );
+        sdb.registerState< Program::PrivateInfo >( Program::TYPE, "PrivateInfo", StateDb::TRANSIENT );
+
+    Mesh::TYPE               = sdb.registerType( "Mesh", 65536, StateDb::GROWABLE, 512 );
+    Mesh::Info::STATE        = sdb.registerState< Mesh::Info >(
+        Mesh::TYPE, "Info", StateDb::TRACK_CHANGES,
+        { STATEDB_FIELD( Mesh::Info, translation, F32, 3 ), STATEDB_FIELD( Mesh::Info, rotation, F32, 4 ),
+          STATEDB_FIELD( Mesh::Info, scale, F32, 3 ), STATEDB_FIELD( Mesh::Info, diffuseMul, F32, 4 ),
+          STATEDB_FIELD( Mesh::Info, ambientAdd, F32, 4 ), STATEDB_FIELD( Mesh::Info, modelAsset, U32, 1 ),
+          STATEDB_FIELD( Mesh::Info, flags, U32, 1 ), STATEDB_FIELD( Mesh::Info, groups, U32, 1 ),
+          STATEDB_FIELD( Mesh::Info, transformHandle, HANDLE, 1 ) } );
+    Mesh::PrivateInfo::STATE =
+        sdb.registerState< Mesh::PrivateInfo >( Mesh::TYPE, "PrivateInfo", StateDb::TRANSIENT );
+    Mesh::PrivateTags::STATE = sdb.registerState< Mesh::PrivateTags >(
+        Mesh::TYPE, "PrivateTags", StateDb::TRACK_CHANGES | StateDb::TRANSIENT );
+
+    Texture::TYPE               = sdb.registerType( "Texture", 256 );
+    Texture::Info::STATE        = sdb.registerState< Texture::Info >( Texture::TYPE, "Info" );
     Texture::PrivateInfo::STATE =
-        sdb.registerState( Texture::TYPE, "PrivateInfo", sizeof( Texture::PrivateInfo ) );
+        sdb.registerState< Texture::PrivateInfo >( Texture::TYPE, "PrivateInfo", StateDb::TRANSIENT );
 
     Camera::TYPE        = sdb.registerType( "Camera", 8 );
-    Camera::Info::STATE = sdb.registerState( Camera::TYPE, "Info", sizeof( Camera::Info ) );
+    Camera::Info::STATE = sdb.registerState< Camera::Info >( Camera::TYPE, "Info" );
 
     Pass::TYPE        = sdb.registerType( "Pass", 8 );
-    Pass::Info::STATE = sdb.registerState( Pass::TYPE, "Info", sizeof( Pass::Info ) );
-
-    /*
-    Transform::TYPE = sdb.registerType("Transform", 4096);
-    Transform::Info::STATE = sdb.registerState(
-        Transform::TYPE, "Info", sizeof(Transform::Info));
-    */
+    Pass::Info::STATE = sdb.registerState< Pass::Info >( Pass::TYPE, "Info" );
+
+    Transform::TYPE        = sdb.registerType( "Transform", 4096 );
+    Transform::Info::STATE = sdb.registerState< Transform::Info >(
+        Transform::TYPE, "Info", StateDb::TRACK_CHANGES,
+        { STATEDB_FIELD( Transform::Info, parentTransformHandle, HANDLE, 1 ),
+          STATEDB_FIELD( Transform::Info, translation, F32, 3 ),
+          STATEDB_FIELD( Transform::Info, rotation, F32, 4 ),
+          STATEDB_FIELD( Transform::Info, scale, F32, 3 ) } );
+    Transform::World::STATE =
+        sdb.registerState< Transform::World >( Transform::TYPE, "World", StateDb::TRANSIENT );
+    Transform::PrivateInfo::STATE =
+        sdb.registerState< Transform::PrivateInfo >( Transform::TYPE, "PrivateInfo", StateDb::TRANSIENT );
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -386,6 +486,17 @@ bool Renderer::initialize( StateDb& sdb, Assets& assets )
     state   = std::make_shared< PrivateState >();
     helpers = std::make_shared< PrivateHelpers >( funcs.get() );
 
+    state->meshChangeConsumer  = sdb.registerChangeConsumer( Mesh::Info::STATE );
+    state->meshLifecycleCursor = sdb.registerLifecycleCursor( Mesh::TYPE );
+
+    state->transformChangeConsumer  = sdb.registerChangeConsumer( Transform::Info::STATE );
+    state->transformLifecycleCursor = sdb.registerLifecycleCursor( Transform::TYPE );
+
+    // No GL resources (programs referred to by passes come from the replayed recording)
+    if ( headless ) {
+        return true;
+    }
+
     if ( !initializeGl() ) {
         return false;
     }
@@ -455,20 +566,22 @@ bool Renderer::initialize( StateDb& sdb, Assets& assets )
 // -------------------------------------------------------------------------------------------------
 void Renderer::shutdown( StateDb& sdb )
 {
-    auto programsPrivate = sdb.stateAll< Program::PrivateInfo >();
-    for ( auto programPrivate : programsPrivate ) {
-        if ( programPrivate->program ) funcs->glDeleteProgram( programPrivate->program );
-        if ( programPrivate->fragmentShader ) funcs->glDeleteShader( programPrivate->fragmentShader );
-        if ( programPrivate->vertexShader ) funcs->glDeleteShader( programPrivate->vertexShader );
-    }
+    if ( !headless ) {
+        auto programsPrivate = sdb.stateAll< Program::PrivateInfo >();
+        for ( auto programPrivate : programsPrivate ) {
+            if ( programPrivate->program ) funcs->glDeleteProgram( programPrivate->program );
+            if ( programPrivate->fragmentShader ) funcs->glDeleteShader( programPrivate->fragmentShader );
+            if ( programPrivate->vertexShader ) funcs->glDeleteShader( programPrivate->vertexShader );
+        }
 
-    for ( auto& meshesIt : state->meshesByModelAsset ) {
-        PrivateMesh* privateMesh = &meshesIt.second;
-        for ( auto& vbosByDataIter : privateMesh->vbosByInitialData ) {
-            funcs->glDeleteBuffers( 1, &vbosByDataIter.second.vbo );
+        for ( auto& meshesIt : state->meshesByModelAsset ) {
+            PrivateMesh* privateMesh = &meshesIt.second;
+            for ( auto& vbosByDataIter : privateMesh->vbosByInitialData ) {
+                funcs->glDeleteBuffers( 1, &vbosByDataIter.second.vbo );
+            }
+            if ( privateMesh->ibo ) funcs->glDeleteBuffers( 1, &privateMesh->ibo );
+            funcs->glDeleteVertexArrays( 1, &meshesIt.second.vao );
         }
-        if ( privateMesh->ibo ) funcs->glDeleteBuffers( 1, &privateMesh->ibo );
-        funcs->glDeleteVertexArrays( 1, &meshesIt.second.vao );
     }
 
     helpers = nullptr;
@@ -490,13 +603,79 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
 
     bool forceProgramUpdate = false;
 
-    // Prepare references to per-model private data
-    auto meshes        = sdb.stateAll< Mesh::Info >();
-    auto meshesPrivate = sdb.stateAll< Mesh::PrivateInfo >();
-    for ( auto meshPrivate : meshesPrivate ) {
-        if ( !meshPrivate->privateMesh ) {
-            auto mesh                = meshes.rel( meshesPrivate, meshPrivate );
+    updateTransforms( sdb );
+
+    // Keep meshes grouped by model so that render passes bind each vertex array once (meshes are
+    // mostly sorted from last frame ==> cheap incremental re-sort)
+    sdb.sortType< Mesh::Info >( []( const Mesh::Info& mesh ) { return u64( mesh.modelAsset ); } );
+
+    // Prepare references to per-model private data (of meshes created since last frame only)
+    sdb.forEachLifecycleEvent(
+        Mesh::TYPE, state->meshLifecycleCursor, [&]( const StateDb::LifecycleEvent& event ) {
+            if ( event.kind == StateDb::LifecycleEvent::DESTROYED ) {
+                state->meshIndex.remove( event.objectHandle );
+                return;
+            }
+            // Meshes destroyed again since do not need private data
+            if ( !sdb.isHandleValid( event.objectHandle ) ) {
+                return;
+            }
+            auto mesh                = sdb.state< Mesh::Info >( event.objectHandle );
+            auto meshPrivate         = sdb.state< Mesh::PrivateInfo >( event.objectHandle );
             meshPrivate->privateMesh = &state->meshesByModelAsset[ mesh->modelAsset ];
+        } );
+    // Update model-to-world transforms and tags of meshes changed since last frame only
+    state->movedMeshIdxs.clear();
+    {
+        auto meshes        = sdb.stateAll< Mesh::Info >();
+        auto meshesPrivate = sdb.stateAll< Mesh::PrivateInfo >();
+        auto meshesTags    = sdb.stateAll< Mesh::PrivateTags >();
+        sdb.forEachChanged< Mesh::Info >( state->meshChangeConsumer, [&]( Mesh::Info* mesh ) {
+            auto meshPrivate = meshesPrivate.rel( meshes, mesh );
+            state->movedMeshIdxs.push_back( u32( mesh - meshes.beginElem + 1 ) );
+            if ( mesh->transformHandle ) {
+                // Forces update relative to transform below
+                meshPrivate->transformVersion = 0;
+            }
+            else {
+                meshPrivate->modelToWorld = meshModelToParent( *mesh );
+            }
+
+            // Only actual tag changes invalidate cached pass selections
+            auto meshTags = meshesTags.rel( meshes, mesh );
+            u64 tagBits   = u64( mesh->groups );
+            if ( mesh->flags & Mesh::Flag::HIDDEN ) {
+                tagBits |= Mesh::PrivateTags::HIDDEN;
+            }
+            if ( mesh->transformHandle ) {
+                tagBits |= Mesh::PrivateTags::TRANSFORMED;
+            }
+            if ( meshTags->bits != tagBits ) {
+                meshTags->bits = tagBits;
+                sdb.markDirty( meshTags );
+            }
+        } );
+    }
+    // Update model-to-world transforms of meshes whose transform changed since last frame
+    {
+        auto meshes        = sdb.stateAll< Mesh::Info >();
+        auto meshesPrivate = sdb.stateAll< Mesh::PrivateInfo >();
+        const std::vector< u32 >& meshIndices =
+            sdb.selectTagged( Mesh::PrivateTags::STATE, Mesh::PrivateTags::TRANSFORMED, 0 );
+        for ( u32 meshIdx : meshIndices ) {
+            auto mesh        = meshes.beginElem + meshIdx - 1;
+            auto meshPrivate = meshesPrivate.beginElem + meshIdx - 1;
+            // Meshes of destroyed transforms keep their last placement
+            if ( !sdb.isHandleValid( mesh->transformHandle ) ) {
+                continue;
+            }
+            auto world = sdb.state< Transform::World >( mesh->transformHandle );
+            if ( meshPrivate->transformVersion == world->version ) {
+                continue;
+            }
+            meshPrivate->transformVersion = world->version;
+            Math::mulMat4( world->localToWorld, meshModelToParent( *mesh ), meshPrivate->modelToWorld );
+            state->movedMeshIdxs.push_back( meshIdx );
         }
     }
     // Prepare per-model private data
@@ -514,14 +693,39 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
         // TODO(martinmo): ==> We need to know about models' attributes for programs...
         // TODO(martinmo): ==> Answer seems to be no ATM
         privateMesh->asset = assets.refModel( modelAsset );
-        COMMON_ASSERT( privateMesh->asset );
         // TODO(martinmo): Add way of getting asset and flags in one call/lookup
         privateMesh->assetInfo = assets.info( modelAsset );
+        if ( headless && !privateMesh->asset ) {
+            // Replays know assets stored in recording only ==> unknown ones are retried next frame
+            // (contents of procedural ones are not recorded ==> without vertices and never indexed)
+            continue;
+        }
+        COMMON_ASSERT( privateMesh->asset );
         COMMON_ASSERT( privateMesh->assetInfo );
         if ( privateMesh->assetInfo->flags & Assets::Flag::DYNAMIC ) {
             privateMesh->flags |= PrivateMesh::Flag::DYNAMIC;
             privateMesh->usage = GL_DYNAMIC_DRAW;
         }
+        // Vertices of dynamic models change every frame ==> not spatially indexed
+        else if ( !privateMesh->asset->positions.empty() ) {
+            const std::vector< glm::fvec3 >& positions = privateMesh->asset->positions;
+            glm::fvec3 boundsMin                       = positions[ 0 ];
+            glm::fvec3 boundsMax                       = positions[ 0 ];
+            for ( const glm::fvec3& position : positions ) {
+                boundsMin = glm::min( boundsMin, position );
+                boundsMax = glm::max( boundsMax, position );
+            }
+            privateMesh->boundsCenter = 0.5f * ( boundsMin + boundsMax );
+            float boundsRadiusSqr     = 0.0f;
+            for ( const glm::fvec3& position : positions ) {
+                glm::fvec3 d    = position - privateMesh->boundsCenter;
+                boundsRadiusSqr = glm::max( boundsRadiusSqr, glm::dot( d, d ) );
+            }
+            privateMesh->boundsRadius = glm::sqrt( boundsRadiusSqr );
+        }
+        if ( headless ) {
+            continue;
+        }
         for ( auto& attr : privateMesh->asset->attrs ) {
             u64 attrStrideInB = attr.offsetInB + attrSize[ attr.type ] * attr.count;
             // FIXME(mmoerth): If attribute 'data' changes we create a new VBO
@@ -556,13 +760,78 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
         }
         privateMesh->flags |= PrivateMesh::Flag::DIRTY;
     }
+    // Update spatial index with world bounds of meshes moved since last frame (in one batch)
+    {
+        state->movedMeshHandles.clear();
+        state->movedMeshCenters.clear();
+        state->movedMeshRadii.clear();
+        auto meshes        = sdb.stateAll< Mesh::Info >();
+        auto meshesPrivate = sdb.stateAll< Mesh::PrivateInfo >();
+        for ( u32 meshIdx : state->movedMeshIdxs ) {
+            auto mesh                = meshes.beginElem + meshIdx - 1;
+            auto meshPrivate         = meshesPrivate.beginElem + meshIdx - 1;
+            PrivateMesh* privateMesh = meshPrivate->privateMesh;
+            u64 meshHandle           = sdb.handleFromState( mesh );
+            // Meshes destroyed (deferred) since left the index with their lifecycle event above ==>
+            // must not be re-inserted under their stale handle (moved by sorting above)
+            if ( !sdb.isHandleValid( meshHandle ) ) {
+                meshPrivate->spatiallyIndexed = false;
+                continue;
+            }
+            if ( !( mesh->groups & WORLD_GROUPS ) || privateMesh->boundsRadius < 0.0f ) {
+                if ( meshPrivate->spatiallyIndexed ) {
+                    state->meshIndex.remove( meshHandle );
+                    meshPrivate->spatiallyIndexed = false;
+                }
+                continue;
+            }
+            meshPrivate->spatiallyIndexed = true;
+
+            // Sphere radius scales with largest axis scale
+            const glm::fmat4& modelToWorld = meshPrivate->modelToWorld;
+            float scale                    = 0.0f;
+            for ( int axis = 0; axis < 3; ++axis ) {
+                scale = glm::max( scale, glm::length( glm::fvec3( modelToWorld[ axis ] ) ) );
+            }
+            glm::fvec4 center = modelToWorld * glm::fvec4( privateMesh->boundsCenter, 1.0f );
+            state->movedMeshHandles.push_back( meshHandle );
+            state->movedMeshCenters.push_back( glm::fvec3( center ) );
+            state->movedMeshRadii.push_back( scale * privateMesh->boundsRadius );
+        }
+        if ( !state->movedMeshHandles.empty() ) {
+            state->meshIndex.update(
+                state->movedMeshHandles.size(), &state->movedMeshHandles[ 0 ],
+                &state->movedMeshCenters[ 0 ], &state->movedMeshRadii[ 0 ] );
+        }
+    }
+
+    // Frustum culling of spatially indexed meshes (stamp marks visible meshes of this frame)
+    {
+        PROFILER_SECTION( Culling, glm::fvec3( 1.0f, 0.0f, 1.0f ) )
+
+        glm::fmat4 projection;
+        glm::fmat4 worldToView;
+        worldCameraTransforms( sdb, activeCameraHandle, projection, worldToView );
+
+        ++state->visibleStamp;
+        state->meshIndex.queryFrustum( projection * worldToView, state->visibleMeshHandles );
+        for ( u64 meshHandle : state->visibleMeshHandles ) {
+            if ( !sdb.isHandleValid( meshHandle ) ) {
+                continue;
+            }
+            sdb.state< Mesh::PrivateInfo >( meshHandle )->visibleStamp = state->visibleStamp;
+        }
+    }
+
+    if ( headless ) {
+        return;
+    }
 
     // Prepare/update programs
-    auto programs        = sdb.stateAll< Program::Info >();
-    auto programsPrivate = sdb.stateAll< Program::PrivateInfo >();
-    for ( auto programPrivate : programsPrivate ) {
+    for ( auto programElems : sdb.view< Program::Info, Program::PrivateInfo >() ) {
+        auto programPrivate = std::get< 1 >( programElems );
         if ( !programPrivate->assetInfo ) {
-            auto program              = programs.rel( programsPrivate, programPrivate );
+            auto program              = std::get< 0 >( programElems );
             programPrivate->assetInfo = assets.info( program->programAsset );
             COMMON_ASSERT( programPrivate->assetInfo )
         }
@@ -620,11 +889,10 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
     }
 
     // Prepare/update textures
-    auto textures        = sdb.stateAll< Texture::Info >();
-    auto texturesPrivate = sdb.stateAll< Texture::PrivateInfo >();
-    for ( auto texturePrivate : texturesPrivate ) {
+    for ( auto textureElems : sdb.view< Texture::Info, Texture::PrivateInfo >() ) {
+        auto texturePrivate = std::get< 1 >( textureElems );
         if ( !texturePrivate->assetInfo ) {
-            auto texture              = textures.rel( texturesPrivate, texturePrivate );
+            auto texture              = std::get< 0 >( textureElems );
             texturePrivate->assetInfo = assets.info( texture->textureAsset );
             COMMON_ASSERT( texturePrivate->assetInfo )
             texturePrivate->asset = assets.refTexture( texture->textureAsset );
@@ -651,13 +919,9 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
     auto emissionPostProgram = sdb.state< Program::PrivateInfo >( state->emissionPostProgramHandle );
 
     {
-        const float aspect    = 16.0f / 9.0f;
-        glm::fmat4 projection = glm::perspective( glm::radians( 30.0f * aspect ), aspect, 0.5f, 200.0f );
+        glm::fmat4 projection;
         glm::fmat4 worldToView;
-        if ( activeCameraHandle ) {
-            auto camera = sdb.state< Camera::Info >( activeCameraHandle );
-            worldToView = glm::lookAt( camera->position, camera->target, glm::fvec3( 0.0f, 0.0f, 1.0f ) );
-        }
+        worldCameraTransforms( sdb, activeCameraHandle, projection, worldToView );
         glm::fvec4 renderParams = glm::fvec4( debugNormals ? 1.0f : 0.0f, 0.0, 0.0, 0.0 );
 
         // Fixed default pass
@@ -666,7 +930,9 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
 
             funcs->glClearColor( 0.15f, 0.15f, 0.15f, 1.0 );
             funcs->glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-            renderPass( sdb, Group::DEFAULT, defaultProgram, projection, worldToView, renderParams );
+            renderPass(
+                sdb, Group::DEFAULT, defaultProgram, projection, worldToView, renderParams,
+                state->visibleStamp );
         }
 
         /*
@@ -761,10 +1027,17 @@ void Renderer::update( StateDb& sdb, Assets& assets, Renderer& renderer, double
     }
 }
 
+// -------------------------------------------------------------------------------------------------
+const SpatialIndex& Renderer::meshSpatialIndex() const
+{
+    COMMON_ASSERT( state );
+    return state->meshIndex;
+}
+
 // -------------------------------------------------------------------------------------------------
 void Renderer::renderPass(
     StateDb& sdb, u32 renderMask, const Program::PrivateInfo* programPrivate, const glm::fmat4& projection,
-    const glm::fmat4& worldToView, const glm::fvec4& renderParams )
+    const glm::fmat4& worldToView, const glm::fvec4& renderParams, u64 visibleStamp )
 {
     funcs->glUseProgram( programPrivate->program );
 
@@ -774,25 +1047,31 @@ void Renderer::renderPass(
     funcs->glUniform4fv( programPrivate->uRenderParams, 1, glm::value_ptr( renderParams ) );
     funcs->glUniformMatrix4fv( programPrivate->uProjectionMatrix, 1, GL_FALSE, glm::value_ptr( projection ) );
 
+    // Visible meshes of pass groups only (selection is cached until tags of meshes change)
     auto meshes        = sdb.stateAll< Mesh::Info >();
     auto meshesPrivate = sdb.stateAll< Mesh::PrivateInfo >();
-
-    // Pseudo-instanced rendering of meshes
-    for ( auto mesh : meshes ) {
-        if ( mesh->flags & Mesh::Flag::HIDDEN ) {
-            continue;
-        }
-        if ( !( mesh->groups & renderMask ) ) {
+    const std::vector< u32 >& meshIdxs =
+        sdb.selectTagged( Mesh::PrivateTags::STATE, 0, renderMask, Mesh::PrivateTags::HIDDEN );
+
+    // Pseudo-instanced rendering of meshes (sorted by model ==> consecutive meshes share VAO)
+    PrivateMesh* boundPrivateMesh = nullptr;
+    for ( u32 meshIdx : meshIdxs ) {
+        auto mesh                = meshes.beginElem + meshIdx - 1;
+        auto meshPrivate         = meshesPrivate.beginElem + meshIdx - 1;
+        PrivateMesh* privateMesh = meshPrivate->privateMesh;
+        if ( visibleStamp && meshPrivate->spatiallyIndexed && meshPrivate->visibleStamp != visibleStamp ) {
             continue;
         }
 
-        auto meshPrivate         = meshesPrivate.rel( meshes, mesh );
-        PrivateMesh* privateMesh = meshPrivate->privateMesh;
-
         // FIXME(martinmo): Use asset version instead of dirty-flag to determine need for update
         // FIXME(martinmo): and move update logic out of 'renderPass()' into 'update()'
         // FIXME(martinmo): ==> We might be able to get rid of 'Mesh::PrivateInfo::flags' too
         if ( privateMesh->flags & PrivateMesh::Flag::DIRTY ) {
+            // Index buffer binding below would otherwise end up in the bound VAO
+            if ( boundPrivateMesh ) {
+                unbindMesh( boundPrivateMesh );
+                boundPrivateMesh = nullptr;
+            }
             // Update/define vertex buffer data
             u64 vertexCount = privateMesh->asset->vertexCount;
             for ( auto& vbosIt : privateMesh->vbosByInitialData ) {
@@ -864,15 +1143,7 @@ void Renderer::renderPass(
             continue;
         }
 
-        glm::fmat4 translation = glm::translate( glm::fmat4( 1.0f ), mesh->translation );
-        glm::fmat4 rotation    = glm::mat4_cast( mesh->rotation );
-
-        glm::fmat4 modelToWorld = translation * rotation;
-        if ( mesh->flags & Mesh::Flag::SCALED ) {
-            glm::fmat4 scale = glm::scale( glm::fmat4( 1.0f ), mesh->scale );
-            modelToWorld     = modelToWorld * scale;
-        }
-
+        const glm::fmat4& modelToWorld = meshPrivate->modelToWorld;
         funcs->glUniformMatrix4fv(
             programPrivate->uModelToWorldMatrix, 1, GL_FALSE, glm::value_ptr( modelToWorld ) );
 
@@ -888,9 +1159,15 @@ void Renderer::renderPass(
         if ( mesh->flags & Mesh::Flag::AMBIENT_ADD ) ambientAdd = mesh->ambientAdd;
         funcs->glUniform4fv( programPrivate->uAmbientAdd, 1, glm::value_ptr( ambientAdd ) );
 
-        funcs->glBindVertexArray( privateMesh->vao );
-        // TODO(martinmo): Should we bind the index buffer as part of the VAO?
-        if ( privateMesh->ibo ) funcs->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, privateMesh->ibo );
+        if ( privateMesh != boundPrivateMesh ) {
+            if ( boundPrivateMesh ) {
+                unbindMesh( boundPrivateMesh );
+            }
+            funcs->glBindVertexArray( privateMesh->vao );
+            // TODO(martinmo): Should we bind the index buffer as part of the VAO?
+            if ( privateMesh->ibo ) funcs->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, privateMesh->ibo );
+            boundPrivateMesh = privateMesh;
+        }
         if ( mesh->flags & Mesh::Flag::DRAW_PARTS ) {
             if ( privateMesh->ibo ) {
                 u64 activeMaterialHint = 0;
@@ -939,23 +1216,124 @@ void Renderer::renderPass(
                 funcs->glDrawArrays( GL_TRIANGLES, 0, GLsizei( privateMesh->vertexCount ) );
             }
         }
-        if ( privateMesh->ibo ) funcs->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
-        funcs->glBindVertexArray( 0 );
+    }
+    if ( boundPrivateMesh ) {
+        unbindMesh( boundPrivateMesh );
     }
     funcs->glUseProgram( 0 );
 }
 
-/*
 // -------------------------------------------------------------------------------------------------
-void Renderer::updateTransforms(StateDb &sdb)
+void Renderer::unbindMesh( const PrivateMesh* privateMesh )
 {
-    auto transforms = sdb.stateAll< Transform::Info >();
-    for (auto transform : transforms)
-    {
-        // ...
+    if ( privateMesh->ibo ) funcs->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    funcs->glBindVertexArray( 0 );
+}
+
+// -------------------------------------------------------------------------------------------------
+void Renderer::updateTransforms( StateDb& sdb )
+{
+    PROFILER_SECTION( UpdateTransforms, glm::fvec3( 0.0f, 0.5f, 1.0f ) )
+
+    // Created/destroyed (or relocated) transforms change parent indices
+    u64 lifecycleEventCount = sdb.forEachLifecycleEvent(
+        Transform::TYPE, state->transformLifecycleCursor, []( const StateDb::LifecycleEvent& ) {} );
+    bool hierarchyChanged = lifecycleEventCount > 0;
+
+    // Elements are indexed like objects (from 1 to count)
+    auto transforms        = sdb.stateAll< Transform::Info >();
+    auto transformsWorld   = sdb.stateAll< Transform::World >();
+    auto transformsPrivate = sdb.stateAll< Transform::PrivateInfo >();
+    Transform::Info* infos           = transforms.beginElem - 1;
+    Transform::World* worlds         = transformsWorld.beginElem - 1;
+    Transform::PrivateInfo* privates = transformsPrivate.beginElem - 1;
+    u64 count                        = u64( transforms.endElem - transforms.beginElem );
+
+    u64 pass = ++state->transformPass;
+    sdb.forEachChanged< Transform::Info >( state->transformChangeConsumer, [&]( Transform::Info* info ) {
+        Transform::PrivateInfo* privateInfo = privates + ( info - infos );
+        privateInfo->dirtyPass              = pass;
+        if ( privateInfo->parentTransformHandle != info->parentTransformHandle ) {
+            privateInfo->parentTransformHandle = info->parentTransformHandle;
+            hierarchyChanged                   = true;
+        }
+    } );
+
+    auto resolveParents = [&]() {
+        for ( u64 idx = 1; idx <= count; ++idx ) {
+            u64 parentHandle          = privates[ idx ].parentTransformHandle;
+            privates[ idx ].parentIdx = 0;
+            if ( !parentHandle ) {
+                continue;
+            }
+            if ( !sdb.isHandleValid( parentHandle ) ) {
+                // Orphans become roots (placed relative to world)
+                privates[ idx ].dirtyPass = pass;
+                continue;
+            }
+            privates[ idx ].parentIdx = u64( sdb.state< Transform::Info >( parentHandle ) - infos );
+        }
+    };
+
+    if ( hierarchyChanged ) {
+        resolveParents();
+
+        // Depths of chains up to first transform of known depth (breaking cycles at their start)
+        const u64 UNKNOWN_DEPTH    = ~0ull;
+        std::vector< u64 >& depths = state->transformDepths;
+        std::vector< u64 >& chain  = state->transformChain;
+        depths.assign( count + 1, UNKNOWN_DEPTH );
+        depths[ 0 ] = 0;
+        for ( u64 idx = 1; idx <= count; ++idx ) {
+            chain.clear();
+            u64 chainIdx = idx;
+            while ( depths[ chainIdx ] == UNKNOWN_DEPTH ) {
+                if ( chain.size() > count ) {
+                    Logger::debug( "WARNING: Transform hierarchy contains cycle (breaking it)" );
+                    privates[ chain.back() ].parentIdx = 0;
+                    break;
+                }
+                chain.push_back( chainIdx );
+                chainIdx = privates[ chainIdx ].parentIdx;
+            }
+            for ( auto chainIter = chain.rbegin(); chainIter != chain.rend(); ++chainIter ) {
+                depths[ *chainIter ]         = depths[ privates[ *chainIter ].parentIdx ] + 1;
+                privates[ *chainIter ].depth = depths[ *chainIter ];
+            }
+        }
+
+        // Breadth-first order: parents are in front of their children (stable ==> mostly sorted)
+        u64 movedCount = sdb.sortType< Transform::PrivateInfo >(
+            []( const Transform::PrivateInfo& privateInfo ) { return privateInfo.depth; } );
+        if ( movedCount ) {
+            // World transforms moved along ==> relocation does not need recomputation
+            sdb.forEachChanged< Transform::Info >(
+                state->transformChangeConsumer, []( Transform::Info* ) {} );
+            resolveParents();
+        }
+    }
+
+    // Propagate in one linear pass (dirty parents are visited before their children)
+    for ( u64 idx = 1; idx <= count; ++idx ) {
+        Transform::PrivateInfo& privateInfo = privates[ idx ];
+        u64 parentIdx                       = privateInfo.parentIdx;
+        if ( parentIdx && privates[ parentIdx ].dirtyPass == pass ) {
+            privateInfo.dirtyPass = pass;
+        }
+        if ( privateInfo.dirtyPass != pass ) {
+            continue;
+        }
+        const Transform::Info& info = infos[ idx ];
+        Transform::World& world     = worlds[ idx ];
+        Math::composeTransform(
+            info.translation, info.rotation, info.scale, world.localToWorld, world.worldToLocal );
+        if ( parentIdx ) {
+            Math::mulMat4( worlds[ parentIdx ].localToWorld, world.localToWorld, world.localToWorld );
+            Math::mulMat4( world.worldToLocal, worlds[ parentIdx ].worldToLocal, world.worldToLocal );
+        }
+        ++world.version;
     }
 }
-*/
 
 // -------------------------------------------------------------------------------------------------
 #define RENDERER_GL_FUNC( Name )                                                                             \
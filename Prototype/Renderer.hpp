@@ -15,6 +15,8 @@
 
 #include "ModuleIf.hpp"
 
+struct SpatialIndex;
+
 // -------------------------------------------------------------------------------------------------
 /// @brief Renderer module
 struct Renderer : public ModuleIf
@@ -50,6 +52,9 @@ struct Renderer : public ModuleIf
             AMBIENT_ADD = 0x08,
             DRAW_PARTS  = 0x10
         };
+        /// Change-tracked ==> modify through 'StateDb::stateMut()' or 'StateDb::markDirty()'
+        // TODO(martinmo): Register as 'StateDb::SPLIT' (hot transform/flags fields apart from
+        // TODO(martinmo): material fields) once change tracking and users work on columns
         struct Info
         {
             static u64 STATE;
@@ -61,8 +66,11 @@ struct Renderer : public ModuleIf
             u32 modelAsset = 0;
             u32 flags      = 0;
             u32 groups     = 0;
+            // Translation/rotation/scale are relative to transform (if not 0)
+            u64 transformHandle = 0;
         };
         struct PrivateInfo;
+        struct PrivateTags;
     };
 
     struct Texture
@@ -138,26 +146,52 @@ struct Renderer : public ModuleIf
         };
     };
 
-    //struct Transform
-    //{
-    //    static u64 TYPE;
-    //    struct Info
-    //    {
-    //        static u64 STATE;
-    //        u64 parentTransformHandle = 0;
-    //        glm::fvec3 translation;
-    //        glm::fquat rotation;
-    //        glm::fmat4 localToWorld;
-    //        glm::fmat4 worldToLocal;
-    //    };
-    //};
+    /// Node of a transform hierarchy (see 'updateTransforms()')
+    struct Transform
+    {
+        static u64 TYPE;
+        /// Local transform relative to parent transform (identity if parent is 0)
+        ///
+        /// Change-tracked ==> modify through 'StateDb::stateMut()' or 'StateDb::markDirty()'
+        struct Info
+        {
+            static u64 STATE;
+            u64 parentTransformHandle = 0;
+            glm::fvec3 translation;
+            glm::fquat rotation;
+            glm::fvec3 scale = glm::fvec3( 1.0f );  // must not be 0 in any component
+        };
+        /// Cached world transform (written by 'updateTransforms()' only)
+        struct World
+        {
+            static u64 STATE;
+            glm::fmat4 localToWorld;
+            glm::fmat4 worldToLocal;
+            u64 version = 0;  // incremented whenever matrices change
+        };
+        struct PrivateInfo;
+    };
 
     u64 activeCameraHandle = 0;
     bool debugNormals      = false;
+    /// Skips all OpenGL work (no window/GL context, e.g. when replaying recordings) ==> 'update()'
+    /// stops after frustum culling (set before 'initialize()')
+    bool headless = false;
 
     Renderer();
     virtual ~Renderer();
 
+    /// Recomputes world transforms of changed transforms and their descendants (called by
+    /// 'update()' ==> modules updated earlier call it to get world transforms of current frame)
+    ///
+    /// Transforms are kept sorted by depth in the hierarchy (parents in front of their children)
+    /// so that world transforms are propagated in one linear pass over the transform states.
+    void updateTransforms( StateDb& sdb );
+
+    /// Bounding spheres of meshes of world groups by mesh handle (shared by culling, sensors and
+    /// gameplay queries) as of last 'update()' (meshes of dynamic models are not included)
+    const SpatialIndex& meshSpatialIndex() const;
+
 public:  // Implementation of module interface
     virtual void registerTypesAndStates( StateDb& sdb );
     virtual bool initialize( StateDb& sdb, Assets& assets );
@@ -177,7 +211,8 @@ private:
     void renderPass(
         StateDb& sdb, u32 renderMask, const Program::PrivateInfo* programPrivate,
         const glm::fmat4& projection, const glm::fmat4& worldToView = glm::fmat4( 1.0f ),
-        const glm::fvec4& renderParams = glm::fvec4( 0.0f ) );
+        const glm::fvec4& renderParams = glm::fvec4( 0.0f ), u64 visibleStamp = 0 );
+    void unbindMesh( const PrivateMesh* privateMesh );
 
     bool initializeGl();
 
@@ -0,0 +1,293 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#include "SpatialIndex.hpp"
+
+#include <algorithm>
+
+const u64 SpatialIndex::LARGE_CELL_KEY;
+
+// Cell coordinates are packed into 21 bits each (about +/- 1M cells per axis)
+static const int CELL_COORD_BITS  = 21;
+static const int CELL_COORD_LIMIT = ( 1 << ( CELL_COORD_BITS - 1 ) ) - 1;
+
+// -------------------------------------------------------------------------------------------------
+static u64 packCellCoords( const glm::ivec3& coords )
+{
+    const u64 mask = ( 1ull << CELL_COORD_BITS ) - 1;
+    return ( u64( coords.x + CELL_COORD_LIMIT ) & mask )
+           | ( ( u64( coords.y + CELL_COORD_LIMIT ) & mask ) << CELL_COORD_BITS )
+           | ( ( u64( coords.z + CELL_COORD_LIMIT ) & mask ) << ( 2 * CELL_COORD_BITS ) );
+}
+
+// -------------------------------------------------------------------------------------------------
+static glm::ivec3 unpackCellCoords( u64 key )
+{
+    const u64 mask = ( 1ull << CELL_COORD_BITS ) - 1;
+    return glm::ivec3(
+        int( key & mask ) - CELL_COORD_LIMIT, int( ( key >> CELL_COORD_BITS ) & mask ) - CELL_COORD_LIMIT,
+        int( ( key >> ( 2 * CELL_COORD_BITS ) ) & mask ) - CELL_COORD_LIMIT );
+}
+
+// -------------------------------------------------------------------------------------------------
+SpatialIndex::SpatialIndex( float cellSizeInM )
+    : m_cellSizeInM( cellSizeInM )
+{
+    COMMON_ASSERT( cellSizeInM > 0.0f );
+}
+
+// -------------------------------------------------------------------------------------------------
+SpatialIndex::~SpatialIndex()
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::update( u64 count, const u64* handles, const glm::fvec3* centers, const float* radii )
+{
+    m_entries.reserve( m_entries.size() + count );
+    for ( u64 i = 0; i < count; ++i ) {
+        update( handles[ i ], centers[ i ], radii[ i ] );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::update( u64 handle, const glm::fvec3& center, float radius )
+{
+    auto entryIdxIter = m_entryIdxByHandle.find( handle );
+    if ( entryIdxIter == m_entryIdxByHandle.end() ) {
+        u64 entryIdx = m_entries.size();
+        m_entries.push_back( Entry() );
+        m_entryIdxByHandle[ handle ] = entryIdx;
+
+        Entry& entry  = m_entries[ entryIdx ];
+        entry.handle  = handle;
+        entry.center  = center;
+        entry.radius  = radius;
+        entry.cellKey = cellKey( center, radius );
+        linkToCell( entryIdx );
+        return;
+    }
+
+    u64 entryIdx = entryIdxIter->second;
+    Entry& entry = m_entries[ entryIdx ];
+    entry.center = center;
+    entry.radius = radius;
+    u64 key      = cellKey( center, radius );
+    if ( key != entry.cellKey ) {
+        unlinkFromCell( entryIdx );
+        entry.cellKey = key;
+        linkToCell( entryIdx );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::remove( u64 handle )
+{
+    auto entryIdxIter = m_entryIdxByHandle.find( handle );
+    if ( entryIdxIter == m_entryIdxByHandle.end() ) {
+        return;
+    }
+    u64 entryIdx = entryIdxIter->second;
+    m_entryIdxByHandle.erase( entryIdxIter );
+    unlinkFromCell( entryIdx );
+
+    // Keep entries dense by moving last entry into hole
+    u64 lastIdx = m_entries.size() - 1;
+    if ( entryIdx != lastIdx ) {
+        Entry& moved                              = m_entries[ entryIdx ];
+        moved                                     = m_entries[ lastIdx ];
+        m_entryIdxByHandle[ moved.handle ]        = entryIdx;
+        m_cells[ moved.cellKey ][ moved.cellPos ] = entryIdx;
+    }
+    m_entries.pop_back();
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 SpatialIndex::count() const
+{
+    return m_entries.size();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::queryRange( const glm::fvec3& center, float radius, std::vector< u64 >& handles ) const
+{
+    handles.clear();
+    glm::fvec3 extent( radius );
+    forEachEntryInBox( center - extent, center + extent, [&]( const Entry& entry ) {
+        float maxDist = radius + entry.radius;
+        glm::fvec3 d  = entry.center - center;
+        if ( glm::dot( d, d ) <= maxDist * maxDist ) {
+            handles.push_back( entry.handle );
+        }
+    } );
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::queryNearest( const glm::fvec3& point, u64 k, std::vector< u64 >& handles ) const
+{
+    handles.clear();
+    if ( !k || m_entries.empty() ) {
+        return;
+    }
+
+    // Range query returns all objects with sphere surfaces within radius ==> grow radius until
+    // it contains at least 'k' objects (the 'k' nearest objects are among them then)
+    float radius = m_cellSizeInM;
+    queryRange( point, radius, m_candidates );
+    while ( m_candidates.size() < k && m_candidates.size() < m_entries.size() ) {
+        radius *= 2.0f;
+        queryRange( point, radius, m_candidates );
+    }
+
+    m_nearest.clear();
+    for ( u64 handle : m_candidates ) {
+        const Entry& entry = m_entries[ m_entryIdxByHandle.find( handle )->second ];
+        float dist         = glm::max( glm::length( entry.center - point ) - entry.radius, 0.0f );
+        m_nearest.push_back( std::make_pair( dist, handle ) );
+    }
+    u64 resultCount = std::min( k, u64( m_nearest.size() ) );
+    std::partial_sort( m_nearest.begin(), m_nearest.begin() + resultCount, m_nearest.end() );
+    for ( u64 i = 0; i < resultCount; ++i ) {
+        handles.push_back( m_nearest[ i ].second );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::queryFrustum( const glm::fmat4& worldToClip, std::vector< u64 >& handles ) const
+{
+    handles.clear();
+
+    // Planes from rows of matrix ("Fast Extraction of Viewing Frustum Planes", Gribb/Hartmann)
+    glm::fvec4 rows[ 4 ];
+    for ( int row = 0; row < 4; ++row ) {
+        const glm::fmat4& m = worldToClip;
+        rows[ row ]         = glm::fvec4( m[ 0 ][ row ], m[ 1 ][ row ], m[ 2 ][ row ], m[ 3 ][ row ] );
+    }
+    glm::fvec4 planes[ 6 ] = { rows[ 3 ] + rows[ 0 ], rows[ 3 ] - rows[ 0 ], rows[ 3 ] + rows[ 1 ],
+                               rows[ 3 ] - rows[ 1 ], rows[ 3 ] + rows[ 2 ], rows[ 3 ] - rows[ 2 ] };
+    for ( glm::fvec4& plane : planes ) {
+        plane /= glm::length( glm::fvec3( plane ) );
+    }
+    auto sphereVisible = [&planes]( const glm::fvec3& center, float radius ) {
+        for ( const glm::fvec4& plane : planes ) {
+            if ( glm::dot( glm::fvec3( plane ), center ) + plane.w < -radius ) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Loose cells are tested through their bounding spheres first (empty cells are never visited)
+    glm::fvec3 halfCell( 0.5f * m_cellSizeInM );
+    float looseCellRadius = 1.5f * glm::length( glm::fvec3( m_cellSizeInM ) );
+    for ( const auto& cell : m_cells ) {
+        if ( cell.first != LARGE_CELL_KEY ) {
+            glm::fvec3 cellCenter = glm::fvec3( unpackCellCoords( cell.first ) ) * m_cellSizeInM + halfCell;
+            if ( !sphereVisible( cellCenter, looseCellRadius ) ) {
+                continue;
+            }
+        }
+        for ( u64 entryIdx : cell.second ) {
+            const Entry& entry = m_entries[ entryIdx ];
+            if ( sphereVisible( entry.center, entry.radius ) ) {
+                handles.push_back( entry.handle );
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 SpatialIndex::cellKey( const glm::fvec3& center, float radius ) const
+{
+    if ( radius > m_cellSizeInM ) {
+        return LARGE_CELL_KEY;
+    }
+    return packCellCoords( cellCoords( center ) );
+}
+
+// -------------------------------------------------------------------------------------------------
+glm::ivec3 SpatialIndex::cellCoords( const glm::fvec3& position ) const
+{
+    // Clamped in float to stay defined for huge (or infinite) query volumes
+    glm::fvec3 coords = glm::floor( position / m_cellSizeInM );
+    float limit       = float( CELL_COORD_LIMIT );
+    coords            = glm::clamp( coords, glm::fvec3( -limit ), glm::fvec3( limit ) );
+    return glm::ivec3( coords );
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::unlinkFromCell( u64 entryIdx )
+{
+    Entry& entry                 = m_entries[ entryIdx ];
+    auto cellIter                = m_cells.find( entry.cellKey );
+    std::vector< u64 >& cellList = cellIter->second;
+
+    // Move last entry of cell into hole
+    u64 movedEntryIdx                  = cellList.back();
+    cellList[ entry.cellPos ]          = movedEntryIdx;
+    m_entries[ movedEntryIdx ].cellPos = entry.cellPos;
+    cellList.pop_back();
+    if ( cellList.empty() ) {
+        m_cells.erase( cellIter );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpatialIndex::linkToCell( u64 entryIdx )
+{
+    Entry& entry                 = m_entries[ entryIdx ];
+    std::vector< u64 >& cellList = m_cells[ entry.cellKey ];
+    entry.cellPos                = cellList.size();
+    cellList.push_back( entryIdx );
+}
+
+// -------------------------------------------------------------------------------------------------
+template< class Func >
+void SpatialIndex::forEachEntryInBox( const glm::fvec3& boxMin, const glm::fvec3& boxMax, Func func ) const
+{
+    auto largeCellIter = m_cells.find( LARGE_CELL_KEY );
+    if ( largeCellIter != m_cells.end() ) {
+        for ( u64 entryIdx : largeCellIter->second ) {
+            func( m_entries[ entryIdx ] );
+        }
+    }
+
+    // Objects reach up to one cell into neighbouring cells
+    glm::ivec3 minCoords = cellCoords( boxMin ) - glm::ivec3( 1 );
+    glm::ivec3 maxCoords = cellCoords( boxMax ) + glm::ivec3( 1 );
+    glm::dvec3 cellCount = glm::dvec3( maxCoords - minCoords ) + glm::dvec3( 1.0 );
+
+    // Visit non-empty cells instead if box covers more cells than there are
+    if ( cellCount.x * cellCount.y * cellCount.z > double( m_cells.size() ) ) {
+        for ( const auto& cell : m_cells ) {
+            if ( cell.first == LARGE_CELL_KEY ) {
+                continue;
+            }
+            glm::ivec3 coords = unpackCellCoords( cell.first );
+            if ( glm::any( glm::lessThan( coords, minCoords ) )
+                 || glm::any( glm::greaterThan( coords, maxCoords ) ) ) {
+                continue;
+            }
+            for ( u64 entryIdx : cell.second ) {
+                func( m_entries[ entryIdx ] );
+            }
+        }
+        return;
+    }
+
+    for ( int z = minCoords.z; z <= maxCoords.z; ++z ) {
+        for ( int y = minCoords.y; y <= maxCoords.y; ++y ) {
+            for ( int x = minCoords.x; x <= maxCoords.x; ++x ) {
+                auto cellIter = m_cells.find( packCellCoords( glm::ivec3( x, y, z ) ) );
+                if ( cellIter == m_cells.end() ) {
+                    continue;
+                }
+                for ( u64 entryIdx : cellIter->second ) {
+                    func( m_entries[ entryIdx ] );
+                }
+            }
+        }
+    }
+}
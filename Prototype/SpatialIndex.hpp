@@ -0,0 +1,77 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#ifndef SPATIALINDEX_HPP
+#define SPATIALINDEX_HPP
+
+#include "Common.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// -------------------------------------------------------------------------------------------------
+/// @brief Loose hashed uniform grid of bounding spheres of objects (identified by handle)
+///
+/// Objects are binned by the cell of their center only and every cell is treated as extending
+/// by one cell size in all directions. Objects with a radius above the cell size are kept in a
+/// separate list that every query scans. Moving an object within its cell only updates its
+/// sphere. Queries return handles of objects whose spheres touch the query volume.
+struct SpatialIndex
+{
+    SpatialIndex( float cellSizeInM = 8.0f );
+    virtual ~SpatialIndex();
+
+    /// Inserts objects or moves them (e.g. all objects moved during a frame)
+    void update( u64 count, const u64* handles, const glm::fvec3* centers, const float* radii );
+    void update( u64 handle, const glm::fvec3& center, float radius );
+    /// Removes object (ignored if object is not in index)
+    void remove( u64 handle );
+
+    u64 count() const;
+
+    /// Objects with spheres intersecting the query sphere
+    void queryRange( const glm::fvec3& center, float radius, std::vector< u64 >& handles ) const;
+    /// (Up to) 'k' objects with the closest sphere surfaces in ascending distance
+    void queryNearest( const glm::fvec3& point, u64 k, std::vector< u64 >& handles ) const;
+    /// Objects with spheres at least partly inside frustum ('worldToClip' is projection * view)
+    void queryFrustum( const glm::fmat4& worldToClip, std::vector< u64 >& handles ) const;
+
+private:
+    struct Entry
+    {
+        u64 handle = 0;
+        glm::fvec3 center;
+        float radius = 0.0f;
+        u64 cellKey  = 0;
+        u64 cellPos  = 0;  // position in entry list of cell
+    };
+
+    static const u64 LARGE_CELL_KEY = ~0ull;
+
+    float m_cellSizeInM = 0.0f;
+    std::vector< Entry > m_entries;
+    std::unordered_map< u64, u64 > m_entryIdxByHandle;
+    // Entry indices by cell (cell of objects above cell size is 'LARGE_CELL_KEY')
+    std::unordered_map< u64, std::vector< u64 > > m_cells;
+
+    // Scratch data of 'queryNearest()'
+    mutable std::vector< std::pair< float, u64 > > m_nearest;
+    mutable std::vector< u64 > m_candidates;
+
+    u64 cellKey( const glm::fvec3& center, float radius ) const;
+    glm::ivec3 cellCoords( const glm::fvec3& position ) const;
+    void unlinkFromCell( u64 entryIdx );
+    void linkToCell( u64 entryIdx );
+
+    template< class Func >
+    void forEachEntryInBox( const glm::fvec3& boxMin, const glm::fvec3& boxMax, Func func ) const;
+
+private:
+    COMMON_DISABLE_COPY( SpatialIndex )
+};
+
+#endif
@@ -5,24 +5,174 @@
 
 #include "StateDb.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined( _M_X64 ) || defined( __SSE2__ )
+#include <emmintrin.h>
+#define STATEDB_SSE2
+#endif
+
+#include "JobSystem.hpp"
 #include "Logger.hpp"
+#include "Platform.hpp"
+
+const u64 StateDb::STATE_ALIGNMENT_IN_B;
+const u64 StateDb::LIFECYCLE_DESTROY_PENDING;
+const u64 StateDb::RESOLVE_PREFETCH_DISTANCE;
+const u64 StateDb::SNAPSHOT_FRESH;
+const u64 StateDb::IMAGE_FORMAT_VERSION;
+const u64 StateDb::SORT_INSERTION_MAX_MOVES_PER_OBJECT;
+
+static const char IMAGE_MAGIC[ 8 ] = { 'S', 'D', 'B', 'I', 'M', 'A', 'G', 'E' };
+
+// -------------------------------------------------------------------------------------------------
+#ifdef STATEDB_SSE2
+/// Compares 64 bit lanes for equality (SSE2 only offers 32 bit comparisons)
+static __m128i cmpEq64( __m128i a, __m128i b )
+{
+    __m128i eq32 = _mm_cmpeq_epi32( a, b );
+    return _mm_and_si128( eq32, _mm_shuffle_epi32( eq32, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+}
+#endif
+
+// -------------------------------------------------------------------------------------------------
+static void selectTags(
+    const u64* tags, u64 count, u64 allMask, u64 anyMask, u64 noneMask, std::vector< u32 >& idxs )
+{
+    u64 i = 0;
+#ifdef STATEDB_SSE2
+    // Tags start 64 B aligned ==> aligned loads
+    const __m128i all      = _mm_set1_epi64x( s64( allMask ) );
+    const __m128i any      = _mm_set1_epi64x( s64( anyMask ) );
+    const __m128i none     = _mm_set1_epi64x( s64( noneMask ) );
+    const __m128i zero     = _mm_setzero_si128();
+    const __m128i anyCheck = anyMask ? _mm_cmpeq_epi32( zero, zero ) : zero;
+    for ( ; i + 2 <= count; i += 2 ) {
+        __m128i tag     = _mm_load_si128( (const __m128i*)( tags + i ) );
+        __m128i allOk   = cmpEq64( _mm_and_si128( tag, all ), all );
+        __m128i noneOk  = cmpEq64( _mm_and_si128( tag, none ), zero );
+        __m128i anyFail = _mm_and_si128( cmpEq64( _mm_and_si128( tag, any ), zero ), anyCheck );
+        __m128i match   = _mm_andnot_si128( anyFail, _mm_and_si128( allOk, noneOk ) );
+        int matchBits   = _mm_movemask_pd( _mm_castsi128_pd( match ) );
+        if ( matchBits & 1 ) {
+            idxs.push_back( u32( i + 1 ) );
+        }
+        if ( matchBits & 2 ) {
+            idxs.push_back( u32( i + 2 ) );
+        }
+    }
+#endif
+    for ( ; i < count; ++i ) {
+        u64 tag = tags[ i ];
+        if ( ( tag & allMask ) == allMask && ( !anyMask || ( tag & anyMask ) ) && !( tag & noneMask ) ) {
+            idxs.push_back( u32( i + 1 ) );
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::Field::Field(
+    const std::string& nameInit, Type typeInit, u64 countInit, u64 offsetInBInit, u64 memberSizeInB )
+    : name( nameInit )
+    , type( typeInit )
+    , count( countInit )
+    , offsetInB( offsetInBInit )
+{
+    COMMON_ASSERT( count > 0 );
+    COMMON_ASSERT( memberSizeInB == 0 || memberSizeInB == sizeInB() );
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::Field::sizeInB() const
+{
+    // Integer types are our typedefs (size of 'u32'/'s32' is platform dependent)
+    switch ( type ) {
+    case Type::U32:
+        return sizeof( u32 ) * count;
+    case Type::S32:
+        return sizeof( s32 ) * count;
+    case Type::U64:
+    case Type::HANDLE:
+        return sizeof( u64 ) * count;
+    case Type::S64:
+        return sizeof( s64 ) * count;
+    case Type::F32:
+        return sizeof( float ) * count;
+    case Type::F64:
+        return sizeof( double ) * count;
+    }
+    return 0;
+}
 
 // -------------------------------------------------------------------------------------------------
-StateDb::StateDb()
+StateDb::StateDb( u64 flags, u64 arenaSizeInB, const std::string& sharedArenaName )
+    : m_reservedObjectCount( 0 )
+    , m_creatorCount( 0 )
+    , m_flags( flags )
+    , m_snapshotSharedIdx( 2 )
+    , m_parallelForDepth( 0 )
 {
     m_types.push_back( Type() );
     m_states.push_back( State() );
+    m_stateData.push_back( StateData() );
+
+    m_memoryPageSize = Platform::memoryPageSize();
+    if ( m_flags & Flag::HUGE_PAGES ) {
+        u64 hugePageSize = Platform::hugeMemoryPageSize();
+        if ( hugePageSize ) {
+            // Use huge pages as unit of commitment so that committed ranges can be huge pages
+            m_memoryPageSize = hugePageSize;
+        }
+        else {
+            Logger::debug( "WARNING: Huge pages not supported on this platform" );
+            m_flags &= ~u64( Flag::HUGE_PAGES );
+        }
+    }
+    COMMON_ASSERT( m_memoryPageSize % STATE_ALIGNMENT_IN_B == 0 );
+
+    // Reserve one extra page to be able to align the arena start to the page size we commit in
+    m_arenaSizeInB = ( arenaSizeInB + m_memoryPageSize - 1 ) / m_memoryPageSize * m_memoryPageSize;
+    m_arenaSizeInB += m_memoryPageSize;
+    if ( !sharedArenaName.empty() ) {
+        m_arena = (unsigned char*)Platform::createSharedMemory( sharedArenaName, m_arenaSizeInB );
+        if ( m_arena ) {
+            m_sharedArenaName = sharedArenaName;
+        }
+        else {
+            Logger::debug( "WARNING: Failed to create shared state arena \"%s\"", sharedArenaName.c_str() );
+        }
+    }
+    if ( !m_arena ) {
+        m_arena = (unsigned char*)Platform::reserveMemory( m_arenaSizeInB );
+    }
+    COMMON_ASSERT( m_arena );
+    m_arenaUsedInB = ( m_memoryPageSize - u64( m_arena ) % m_memoryPageSize ) % m_memoryPageSize;
+
+    if ( ( m_flags & Flag::HUGE_PAGES ) && !Platform::adviseHugePages( m_arena, m_arenaSizeInB ) ) {
+        Logger::debug( "WARNING: Failed to enable huge pages for state arena" );
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
 StateDb::~StateDb()
 {
     for ( auto& type : m_types ) {
-        if ( type.objectCount > 0 ) {
+        if ( type.objectCount > 0 && !m_fork ) {
             Logger::debug(
                 "WARNING: Detected %d active \"%s\"-objects", type.objectCount, type.name.c_str() );
         }
     }
+    if ( !m_arena ) {
+        // Fork failed to map its base
+    }
+    else if ( m_sharedArenaName.empty() ) {
+        Platform::releaseMemory( m_arena, m_arenaSizeInB );
+    }
+    else {
+        Platform::destroySharedMemory( m_sharedArenaName, m_arena, m_arenaSizeInB );
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -42,9 +192,10 @@ u64 StateDb::typeIdByName( const std::string& name )
 }
 
 // -------------------------------------------------------------------------------------------------
-u64 StateDb::registerType( const std::string& name, u64 maxObjectCount )
+u64 StateDb::registerType( const std::string& name, u64 maxObjectCount, u64 flags, u64 pageObjectCount )
 {
     COMMON_ASSERT( maxObjectCount > 0 );
+    COMMON_ASSERT( pageObjectCount > 0 );
     COMMON_ASSERT( name.length() > 0 );
     u64 existingTypeId = typeIdByName( name );
     if ( existingTypeId ) {
@@ -63,10 +214,22 @@ u64 StateDb::registerType( const std::string& name, u64 maxObjectCount )
     // Make sure we can store the highest object ID in an object handle
     COMMON_ASSERT( newType.maxObjectCount <= 0xffffffff );
 
-    newType.lifecycleByObjectId.resize( maxObjectCount + 1, 0 );
-    newType.objectIdToIdx.resize( maxObjectCount + 1, 0 );
-    newType.idxToObjectId.resize( maxObjectCount + 1, 0 );
-    for ( int id = 0; id < maxObjectCount + 1; ++id ) {
+    newType.flags           = flags;
+    newType.pageObjectCount = pageObjectCount;
+    // Growable types start out empty and commit memory page by page on demand
+    newType.objectCapacity = ( flags & TypeFlag::GROWABLE ) ? 0 : maxObjectCount;
+
+    newType.schemaHash = hashBytes( name.data(), name.length() );
+    newType.schemaHash = hashBytes( &newType.maxObjectCount, sizeof( u64 ), newType.schemaHash );
+    newType.schemaHash = hashBytes( &newType.flags, sizeof( u64 ), newType.schemaHash );
+    newType.schemaHash = hashBytes( &newType.pageObjectCount, sizeof( u64 ), newType.schemaHash );
+
+    newType.reservations = std::make_shared< Reservations >();
+
+    newType.lifecycleByObjectId.resize( newType.objectCapacity + 1, 0 );
+    newType.objectIdToIdx.resize( newType.objectCapacity + 1, 0 );
+    newType.idxToObjectId.resize( newType.objectCapacity + 1, 0 );
+    for ( u64 id = 0; id < newType.objectCapacity + 1; ++id ) {
         newType.objectIdToIdx[ id ] = id;
         newType.idxToObjectId[ id ] = id;
     }
@@ -101,11 +264,10 @@ std::string StateDb::stateNameById( u64 stateId )
 }
 
 // -------------------------------------------------------------------------------------------------
-u64 StateDb::registerState( u64 typeId, const std::string& name, u64 elemSize )
+u64 StateDb::registerState(
+    u64 typeId, const std::string& name, u64 elemSize, const void* defaultElem, u64 flags,
+    const std::vector< Field >& fields )
 {
-    // TODO(martinmo): Implemnt this as template method and use 'std::is_pod()'
-    // TODO(martinmo): to make sure state struct contains POD types only
-
     // Element size has to be non-zero and a multiple of 4 B (32 bit)
     COMMON_ASSERT( elemSize > 0 );
     COMMON_ASSERT( elemSize % 4 == 0 );
@@ -124,25 +286,201 @@ u64 StateDb::registerState( u64 typeId, const std::string& name, u64 elemSize )
         return existingStateId;
     }
 
+    for ( const Field& field : fields ) {
+        COMMON_ASSERT( field.offsetInB + field.sizeInB() <= elemSize );
+    }
+
     State newState;
     newState.name     = internalName;
     newState.id       = m_states.size();
     newState.typeId   = typeId;
     newState.elemSize = elemSize;
+    newState.flags    = flags;
+    newState.fields   = fields;
+
+    if ( flags & StateFlag::SPLIT ) {
+        return registerSplitState( type, newState, name, defaultElem );
+    }
+
+    // Shift values so that element 1 (first live element) starts on an aligned address
+    newState.valuesOffsetInB = roundUpToStateAlignment( newState.elemSize ) - newState.elemSize;
+
+    // Take region for the maximum object count from the arena right away but only commit what
+    // is needed for the current capacity (everything for non-growable types)
+    u64 reservedInB      = stateSizeInB( newState, type.maxObjectCount );
+    newState.reservedInB = ( reservedInB + m_memoryPageSize - 1 ) / m_memoryPageSize * m_memoryPageSize;
+    if ( m_arenaUsedInB + newState.reservedInB > m_arenaSizeInB ) {
+        Logger::debug( "ERROR: Out of arena memory for state \"%s\"", internalName.c_str() );
+        COMMON_ASSERT( false );
+        return 0;
+    }
+    newState.memory = m_arena + m_arenaUsedInB;
+    m_arenaUsedInB += newState.reservedInB;
+
+    if ( !commitStateMemory( newState, type.objectCapacity ) ) {
+        Logger::debug( "ERROR: Failed to commit memory for state \"%s\"", internalName.c_str() );
+        COMMON_ASSERT( false );
+    }
+
+    // Only keep default element around if it is non-zero (committed memory is zeroed)
+    if ( defaultElem ) {
+        const unsigned char* defaultBytes = (const unsigned char*)defaultElem;
+        if ( std::find_if( defaultBytes, defaultBytes + elemSize, []( unsigned char b ) { return b != 0; } )
+            != defaultBytes + elemSize ) {
+            newState.defaultElem.assign( defaultBytes, defaultBytes + elemSize );
+        }
+    }
+
+    // Change tracking does not affect what is stored ==> not part of schema
+    u64 schemaFlags     = flags & StateFlag::TRANSIENT;
+    newState.schemaHash = hashBytes( internalName.data(), internalName.length() );
+    newState.schemaHash = hashBytes( &newState.elemSize, sizeof( u64 ), newState.schemaHash );
+    newState.schemaHash = hashBytes( &schemaFlags, sizeof( u64 ), newState.schemaHash );
+    if ( !newState.defaultElem.empty() ) {
+        newState.schemaHash = hashBytes( &newState.defaultElem[ 0 ], elemSize, newState.schemaHash );
+    }
+    newState.schemaHash = hashFields( newState.fields, newState.schemaHash );
+
+    if ( flags & StateFlag::TRACK_CHANGES ) {
+        newState.changes            = std::make_shared< ChangeTracking >();
+        newState.changes->wordCount = ( type.maxObjectCount + 1 + 63 ) / 64;
+    }
 
     m_states.push_back( newState );
     type.stateIds.push_back( newState.id );
     m_stateIdsByName[ internalName ] = newState.id;
 
-    m_stateValues.resize( newState.id + 1 );
-    // FIXME(martinmo): If we want to support non-0 default values for state fields
-    // FIXME(martinmo): we would have to use placement new to construct elements here...
-    // FIXME(martinmo): ==> Better 'memcpy()' from default initialized 0-element?
-    m_stateValues[ newState.id ].resize( newState.elemSize * ( type.maxObjectCount + 1 ) );
+    StateData newStateData;
+    newStateData.values              = newState.memory + newState.valuesOffsetInB;
+    newStateData.objectIdToIdx       = &type.objectIdToIdx[ 0 ];
+    newStateData.lifecycleByObjectId = &type.lifecycleByObjectId[ 0 ];
+    newStateData.objectCount         = type.objectCount;
+    newStateData.objectCapacity      = type.objectCapacity;
+    newStateData.elemSize            = newState.elemSize;
+    newStateData.typeId              = typeId;
+    newStateData.changes             = newState.changes.get();
+    m_stateData.push_back( newStateData );
+
+    // All elements of a new state are unused ==> initialize them to default
+    if ( !newState.defaultElem.empty() ) {
+        resetElems( newState.id, 1, type.objectCapacity );
+    }
 
     return newState.id;
 }
 
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::registerSplitState(
+    Type& type, State& newState, const std::string& name, const void* defaultElem )
+{
+    // Fields are the only way to access elements (and changes are tracked per element)
+    COMMON_ASSERT( !newState.fields.empty() );
+    COMMON_ASSERT( !( newState.flags & StateFlag::TRACK_CHANGES ) );
+
+    u64 schemaFlags     = newState.flags & ( StateFlag::TRANSIENT | StateFlag::SPLIT );
+    newState.schemaHash = hashBytes( newState.name.data(), newState.name.length() );
+    newState.schemaHash = hashBytes( &newState.elemSize, sizeof( u64 ), newState.schemaHash );
+    newState.schemaHash = hashBytes( &schemaFlags, sizeof( u64 ), newState.schemaHash );
+    newState.schemaHash = hashFields( newState.fields, newState.schemaHash );
+
+    // State itself owns no memory (and is no member of 'type.stateIds') ==> all structural
+    // changes, growth, images, ... are handled by its column states
+    u64 stateId = newState.id;
+    m_states.push_back( newState );
+    m_stateIdsByName[ newState.name ] = stateId;
+
+    StateData newStateData;
+    newStateData.elemSize = newState.elemSize;
+    newStateData.typeId   = type.id;
+    m_stateData.push_back( newStateData );
+
+    std::vector< unsigned char > defaultBytes( newState.elemSize, 0 );
+    if ( defaultElem ) {
+        memcpy( &defaultBytes[ 0 ], defaultElem, newState.elemSize );
+    }
+    u64 columnFlags = newState.flags & ~u64( StateFlag::SPLIT );
+    // Registering columns grows 'm_states' ==> iterate over caller's copy of the fields
+    for ( const Field& field : newState.fields ) {
+        u64 columnStateId = registerState(
+            type.id, name + "." + field.name, field.sizeInB(), &defaultBytes[ field.offsetInB ],
+            columnFlags );
+        m_states[ columnStateId ].splitStateId = stateId;
+        m_states[ stateId ].columnStateIds.push_back( columnStateId );
+    }
+
+    return stateId;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::typeCount()
+{
+    return m_types.size() - 1;
+}
+
+// -------------------------------------------------------------------------------------------------
+std::string StateDb::typeNameById( u64 typeId )
+{
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    return m_types[ typeId ].name;
+}
+
+// -------------------------------------------------------------------------------------------------
+std::vector< u64 > StateDb::typeStateIds( u64 typeId )
+{
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    std::vector< u64 > stateIds;
+    for ( u64 stateId = 1; stateId < m_states.size(); ++stateId ) {
+        if ( m_states[ stateId ].typeId == typeId && !m_states[ stateId ].splitStateId ) {
+            stateIds.push_back( stateId );
+        }
+    }
+    return stateIds;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::stateFlags( u64 stateId )
+{
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    return m_states[ stateId ].flags;
+}
+
+// -------------------------------------------------------------------------------------------------
+std::vector< StateDb::Field > StateDb::stateFields( u64 stateId )
+{
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    return m_states[ stateId ].fields;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::objectHandleByIdx( u64 typeId, u64 idx )
+{
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    const Type& type = m_types[ typeId ];
+    COMMON_ASSERT( idx >= 1 && idx <= type.objectCount );
+    u64 objectId = type.idxToObjectId[ idx ];
+    return composeObjectHandle( u16( typeId ), u16( type.lifecycleByObjectId[ objectId ] ), u32( objectId ) );
+}
+
+// -------------------------------------------------------------------------------------------------
+void* StateDb::fieldValue( u64 stateId, u64 fieldIdx, u64 objectHandle )
+{
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    const State& state = m_states[ stateId ];
+    COMMON_ASSERT( fieldIdx < state.fields.size() );
+
+    u64 offsetInB = state.fields[ fieldIdx ].offsetInB;
+    if ( state.flags & StateFlag::SPLIT ) {
+        stateId   = state.columnStateIds[ fieldIdx ];
+        offsetInB = 0;
+    }
+    const StateData& data = m_stateData[ stateId ];
+    if ( !isHandleValid( data, objectHandle ) ) {
+        return nullptr;
+    }
+    u64 idx = data.objectIdToIdx[ objectHandleObjectId( objectHandle ) ];
+    return data.values + idx * data.elemSize + offsetInB;
+}
+
 // -------------------------------------------------------------------------------------------------
 bool StateDb::isHandleValid( u64 objectHandle )
 {
@@ -152,7 +490,7 @@ bool StateDb::isHandleValid( u64 objectHandle )
     }
     const Type& type = m_types[ typeId ];
     u32 objectId     = objectHandleObjectId( objectHandle );
-    if ( objectId < 1 || objectId > type.maxObjectCount ) {
+    if ( objectId < 1 || objectId > type.objectCapacity ) {
         return false;
     }
     u16 lifecycle = objectHandleLifecycle( objectHandle );
@@ -172,6 +510,7 @@ std::string StateDb::handleTypeName( u64 objectHandle )
 // -------------------------------------------------------------------------------------------------
 void StateDb::destroy( u64 objectHandle )
 {
+    assertNoParallelFor();
     COMMON_ASSERT( isHandleValid( objectHandle ) );
 
     Type& type   = m_types[ objectHandleTypeId( objectHandle ) ];
@@ -183,35 +522,33 @@ void StateDb::destroy( u64 objectHandle )
         u64 idxToDestroy     = type.objectIdToIdx[ objectId ];
         u64 objectIdToSwapIn = type.idxToObjectId[ type.objectCount ];
         for ( u64 stateId : type.stateIds ) {
-            State& state = m_states[ stateId ];
+            StateData& state = m_stateData[ stateId ];
             // Swap in state memory of last object to fill hole
             memcpy(
-                &m_stateValues[ stateId ][ state.elemSize * idxToDestroy ],
-                &m_stateValues[ stateId ][ state.elemSize * type.objectCount ], state.elemSize );
-            // Zero previous state memory of swapped in object
-            // FIXME(martinmo): If we want to support non-0 default values for state fields
-            // FIXME(martinmo): we would have to use placement new to reset the element here...
-            // FIXME(martinmo): ==> Better 'memcpy()' from default initialized 0-element?
-            memset( &m_stateValues[ stateId ][ state.elemSize * type.objectCount ], 0, state.elemSize );
+                state.values + state.elemSize * idxToDestroy,
+                state.values + state.elemSize * type.objectCount, state.elemSize );
+            // Reset previous state memory of swapped in object
+            resetElems( stateId, type.objectCount, 1 );
         }
+        markObjectsDirty( type, idxToDestroy, 1 );
         std::swap( type.objectIdToIdx[ objectIdToSwapIn ], type.objectIdToIdx[ objectId ] );
         std::swap( type.idxToObjectId[ type.objectCount ], type.idxToObjectId[ idxToDestroy ] );
     }
     else {
-        // Zero memory of destroyed object's states
-        // FIXME(martinmo): If we want to support non-0 default values for state fields
-        // FIXME(martinmo): we would have to use placement new to reset the element here...
-        // FIXME(martinmo): ==> Better 'memcpy()' from default initialized 0-element?
+        // Reset memory of destroyed object's states
         for ( u64 stateId : type.stateIds ) {
-            State& state = m_states[ stateId ];
-            memset( &m_stateValues[ stateId ][ state.elemSize * type.objectCount ], 0, state.elemSize );
+            resetElems( stateId, type.objectCount, 1 );
         }
     }
 
     ++type.lifecycleByObjectId[ objectId ];
     COMMON_ASSERT( objectHandleLifecycle( objectHandle ) != type.lifecycleByObjectId[ objectId ] );
+    ++type.layoutVersion;
+    type.relationsDirty = true;
+    journalDestroy( type, objectHandle );
 
     --type.objectCount;
+    updateObjectCount( type );
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -221,6 +558,1423 @@ int StateDb::count( u64 typeId )
     return int( m_types[ typeId ].objectCount );
 }
 
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::createObject( u64 typeId )
+{
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    u64 createdObjectHandle = 0;
+    createObjects( m_types[ typeId ], 1, &createdObjectHandle );
+    return createdObjectHandle;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::reserveObjects( u64 typeId, u64 count )
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    Type& type = m_types[ typeId ];
+    while ( type.objectCount + count > type.objectCapacity ) {
+        if ( !growType( type ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::Creator::Creator( StateDb& sdb, u64 typeId, u64 blockObjectCount )
+    : m_sdb( &sdb )
+    , m_typeId( typeId )
+    , m_blockObjectCount( blockObjectCount )
+{
+    COMMON_ASSERT( sdb.isTypeIdValid( typeId ) );
+    COMMON_ASSERT( blockObjectCount > 0 );
+    m_sdb->m_creatorCount.fetch_add( 1 );
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::Creator::~Creator()
+{
+    releaseBlock();
+    m_sdb->m_creatorCount.fetch_sub( 1 );
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::Creator::reserveIdx()
+{
+    if ( m_nextIdx == m_endIdx ) {
+        releaseBlock();
+
+        // Live objects do not change while creators are active ==> slots follow them
+        const Type& type  = m_sdb->m_types[ m_typeId ];
+        u64 reservedCount = type.reservations->count.fetch_add( m_blockObjectCount );
+        m_sdb->m_reservedObjectCount.fetch_add( m_blockObjectCount );
+        u64 firstIdx = type.objectCount + 1 + reservedCount;
+        u64 endIdx   = std::min( firstIdx + m_blockObjectCount, type.objectCapacity + 1 );
+        if ( firstIdx >= endIdx ) {
+            // Out of capacity (slots past capacity are dropped on flush)
+            return 0;
+        }
+        m_nextIdx = firstIdx;
+        m_endIdx  = endIdx;
+    }
+    return m_nextIdx++;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::Creator::releaseBlock()
+{
+    if ( m_nextIdx == m_endIdx ) {
+        return;
+    }
+    Reservations& reservations = *m_sdb->m_types[ m_typeId ].reservations;
+    {
+        std::lock_guard< std::mutex > lock( reservations.mutex );
+        reservations.unusedRanges.push_back( std::make_pair( m_nextIdx, m_endIdx ) );
+    }
+    m_nextIdx = 0;
+    m_endIdx  = 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::CommandBuffer::CommandBuffer( StateDb& sdb )
+    : m_sdb( &sdb )
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::CommandBuffer::~CommandBuffer()
+{
+    submit();
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::CommandBuffer::destroy( u64 objectHandle )
+{
+    record( Command::DESTROY, objectHandle, 0, nullptr, 0 );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::CommandBuffer::submit()
+{
+    m_creators.clear();
+    if ( m_commands.empty() ) {
+        return;
+    }
+    {
+        std::lock_guard< std::mutex > lock( m_sdb->m_submittedCommandsMutex );
+        m_sdb->m_submittedCommands.push_back( std::move( m_commands ) );
+    }
+    m_commands.clear();
+    m_commandCount = 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::CommandBuffer::commandCount() const
+{
+    return m_commandCount;
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::Creator& StateDb::CommandBuffer::creator( u64 typeId )
+{
+    if ( typeId >= m_creators.size() ) {
+        m_creators.resize( typeId + 1 );
+    }
+    if ( !m_creators[ typeId ] ) {
+        m_creators[ typeId ] = std::make_shared< Creator >( *m_sdb, typeId );
+    }
+    return *m_creators[ typeId ];
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::CommandBuffer::record(
+    u64 kind, u64 objectHandle, u64 stateId, const void* payload, u64 sizeInB )
+{
+    // Keep headers 8 B aligned for playback
+    u64 offsetInB = m_commands.size();
+    m_commands.resize( offsetInB + sizeof( Command ) + ( ( sizeInB + 7 ) & ~7ull ) );
+    Command* command      = (Command*)&m_commands[ offsetInB ];
+    command->kind         = kind;
+    command->objectHandle = objectHandle;
+    command->stateId      = stateId;
+    command->sizeInB      = sizeInB;
+    if ( sizeInB ) {
+        memcpy( command + 1, payload, sizeInB );
+    }
+    ++m_commandCount;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::activateReserved( Type& type, u64 idx )
+{
+    // Slot is owned by calling creator only ==> no synchronization needed
+    u64 objectId   = type.idxToObjectId[ idx ];
+    u64& lifecycle = type.lifecycleByObjectId[ objectId ];
+    ++lifecycle;
+    return composeObjectHandle( u16( type.id ), u16( lifecycle ), u32( objectId ) );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::flushCreates()
+{
+    // Blocks of creators still around would count as used
+    COMMON_ASSERT( m_parallelForDepth.load() == 0 );
+    COMMON_ASSERT( m_creatorCount.load() == 0 );
+    if ( !m_reservedObjectCount.load() ) {
+        return;
+    }
+    for ( u64 typeId = 1; typeId < m_types.size(); ++typeId ) {
+        flushCreates( m_types[ typeId ] );
+    }
+    m_reservedObjectCount.store( 0 );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::flushCreates( Type& type )
+{
+    Reservations& reservations = *type.reservations;
+    // Slots reserved past capacity were never handed out
+    u64 reservedCount = std::min( reservations.count.load(), type.objectCapacity - type.objectCount );
+    if ( !reservedCount ) {
+        reservations.count.store( 0 );
+        reservations.unusedRanges.clear();
+        return;
+    }
+
+    // Reserved slots [firstIdx, endIdx) minus unused ones have to become packed at 'firstIdx'
+    u64 firstIdx = type.objectCount + 1;
+    u64 endIdx   = firstIdx + reservedCount;
+    std::vector< bool > used( reservedCount, true );
+    u64 usedCount = reservedCount;
+    for ( auto& range : reservations.unusedRanges ) {
+        for ( u64 idx = range.first; idx < std::min( range.second, endIdx ); ++idx ) {
+            used[ idx - firstIdx ] = false;
+            --usedCount;
+        }
+    }
+    reservations.count.store( 0 );
+    reservations.unusedRanges.clear();
+
+    // Fill unused slots below the packed end with used slots from above it (in order)
+    u64 packedEndIdx = firstIdx + usedCount;
+    u64 srcIdx       = packedEndIdx;
+    for ( u64 idx = firstIdx; idx < packedEndIdx; ++idx ) {
+        if ( used[ idx - firstIdx ] ) {
+            continue;
+        }
+        while ( !used[ srcIdx - firstIdx ] ) {
+            ++srcIdx;
+        }
+        COMMON_ASSERT( srcIdx < endIdx );
+        for ( u64 stateId : type.stateIds ) {
+            StateData& state = m_stateData[ stateId ];
+            memcpy(
+                state.values + state.elemSize * idx, state.values + state.elemSize * srcIdx, state.elemSize );
+            resetElems( stateId, srcIdx, 1 );
+        }
+        std::swap( type.idxToObjectId[ idx ], type.idxToObjectId[ srcIdx ] );
+        type.objectIdToIdx[ type.idxToObjectId[ idx ] ]    = idx;
+        type.objectIdToIdx[ type.idxToObjectId[ srcIdx ] ] = srcIdx;
+        ++srcIdx;
+    }
+
+    type.objectCount += usedCount;
+    updateObjectCount( type );
+    markObjectsDirty( type, firstIdx, usedCount );
+    journalCreates( type, firstIdx, usedCount );
+    ++type.layoutVersion;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::playbackCommands()
+{
+    flushCreates();
+    // Command buffers submit from any thread at any time (on destruction) ==> take over buffers
+    // submitted so far (later ones are played back next time)
+    {
+        std::lock_guard< std::mutex > lock( m_submittedCommandsMutex );
+        m_playbackCommands.swap( m_submittedCommands );
+    }
+    if ( m_playbackCommands.empty() ) {
+        return;
+    }
+
+    // Resolve writes to indices (created objects are in place now) and batch them by state
+    u64 skippedCount = 0;
+    m_playbackWrites.clear();
+    for ( auto& commands : m_playbackCommands ) {
+        for ( u64 offsetInB = 0; offsetInB < commands.size(); ) {
+            auto command = (const CommandBuffer::Command*)&commands[ offsetInB ];
+            offsetInB += sizeof( CommandBuffer::Command ) + ( ( command->sizeInB + 7 ) & ~7ull );
+            if ( command->kind != CommandBuffer::Command::WRITE ) {
+                continue;
+            }
+            const StateData& data = m_stateData[ command->stateId ];
+            if ( !isHandleValid( data, command->objectHandle ) ) {
+                ++skippedCount;
+                continue;
+            }
+            u64 idx = data.objectIdToIdx[ objectHandleObjectId( command->objectHandle ) ];
+            m_playbackWrites.push_back( std::make_pair( command->stateId << 32 | idx, command ) );
+        }
+    }
+    // Stable ==> recording order is kept for writes to same element
+    std::stable_sort(
+        m_playbackWrites.begin(), m_playbackWrites.end(),
+        []( const std::pair< u64, const CommandBuffer::Command* >& a,
+            const std::pair< u64, const CommandBuffer::Command* >& b ) { return a.first < b.first; } );
+    for ( auto& write : m_playbackWrites ) {
+        const StateData& data = m_stateData[ write.second->stateId ];
+        u64 idx               = write.first & 0xffffffffull;
+        COMMON_ASSERT( write.second->sizeInB == data.elemSize );
+        memcpy( data.values + idx * data.elemSize, write.second + 1, data.elemSize );
+        markDirty( data, idx );
+    }
+    m_playbackWrites.clear();
+
+    // Destroys last so that writes to objects destroyed in the same batch do not get lost silently
+    for ( auto& commands : m_playbackCommands ) {
+        for ( u64 offsetInB = 0; offsetInB < commands.size(); ) {
+            auto command = (const CommandBuffer::Command*)&commands[ offsetInB ];
+            offsetInB += sizeof( CommandBuffer::Command ) + ( ( command->sizeInB + 7 ) & ~7ull );
+            if ( command->kind != CommandBuffer::Command::DESTROY ) {
+                continue;
+            }
+            // Several buffers may destroy the same object
+            if ( !isHandleValid( command->objectHandle ) ) {
+                continue;
+            }
+            destroyDeferred( command->objectHandle );
+        }
+    }
+    m_playbackCommands.clear();
+
+    if ( skippedCount ) {
+        Logger::debug(
+            "WARNING: Skipped %d writes to objects destroyed before playback", int( skippedCount ) );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::sortType( u64 typeId, const std::function< u64( u64 idx ) >& keyFunc )
+{
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    Type& type = m_types[ typeId ];
+    m_sortKeys.resize( type.objectCount );
+    for ( u64 i = 0; i < type.objectCount; ++i ) {
+        m_sortKeys[ i ] = keyFunc( i + 1 );
+    }
+    return sortObjects( type );
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::sortObjects( Type& type )
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( m_sortKeys.size() == type.objectCount );
+
+    u64 count = type.objectCount;
+    m_sortItems.resize( count );
+    bool sorted = true;
+    for ( u64 i = 0; i < count; ++i ) {
+        m_sortItems[ i ].key = m_sortKeys[ i ];
+        m_sortItems[ i ].idx = i + 1;
+        sorted               = sorted && ( i == 0 || m_sortKeys[ i - 1 ] <= m_sortKeys[ i ] );
+    }
+    if ( sorted ) {
+        return 0;
+    }
+
+    // Items stay a (stably ordered) permutation if insertion sort gives up ==> continue with radix
+    if ( !insertionSort( &m_sortItems[ 0 ], count, count * SORT_INSERTION_MAX_MOVES_PER_OBJECT ) ) {
+        radixSort( m_sortItems, m_sortItemsTmp );
+    }
+
+    // Decompose permutation (new index <- old index) into cycles separated by 0 (no valid index)
+    m_sortCycles.clear();
+    u64 movedCount = 0;
+    for ( u64 i = 0; i < count; ++i ) {
+        u64 idx = i + 1;
+        if ( m_sortItems[ i ].idx == idx ) {
+            continue;
+        }
+        while ( m_sortItems[ idx - 1 ].idx != idx ) {
+            m_sortCycles.push_back( idx );
+            u64 srcIdx                 = m_sortItems[ idx - 1 ].idx;
+            m_sortItems[ idx - 1 ].idx = idx;
+            idx                        = srcIdx;
+            ++movedCount;
+        }
+        m_sortCycles.push_back( 0 );
+    }
+
+    // Rotate elements along each cycle (one temporary element per state)
+    auto permute = [this]( unsigned char* elems, u64 elemSize ) {
+        m_sortElem.resize( elemSize );
+        u64 firstIdx = 0;
+        u64 prevIdx  = 0;
+        for ( u64 idx : m_sortCycles ) {
+            if ( !firstIdx ) {
+                memcpy( &m_sortElem[ 0 ], elems + idx * elemSize, elemSize );
+                firstIdx = idx;
+            }
+            else if ( idx ) {
+                memcpy( elems + prevIdx * elemSize, elems + idx * elemSize, elemSize );
+            }
+            else {
+                memcpy( elems + prevIdx * elemSize, &m_sortElem[ 0 ], elemSize );
+                firstIdx = 0;
+            }
+            prevIdx = idx;
+        }
+    };
+    for ( u64 stateId : type.stateIds ) {
+        permute( m_stateData[ stateId ].values, m_stateData[ stateId ].elemSize );
+    }
+    permute( (unsigned char*)&type.idxToObjectId[ 0 ], sizeof( u64 ) );
+    for ( u64 idx : m_sortCycles ) {
+        if ( idx ) {
+            type.objectIdToIdx[ type.idxToObjectId[ idx ] ] = idx;
+            markObjectsDirty( type, idx, 1 );
+        }
+    }
+    ++type.layoutVersion;
+
+    return movedCount;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::insertionSort( SortItem* items, u64 count, u64 maxMoveCount )
+{
+    u64 moveCount = 0;
+    for ( u64 i = 1; i < count; ++i ) {
+        if ( items[ i - 1 ].key <= items[ i ].key ) {
+            continue;
+        }
+        SortItem item = items[ i ];
+        u64 j         = i;
+        for ( ; j > 0 && items[ j - 1 ].key > item.key; --j ) {
+            items[ j ] = items[ j - 1 ];
+        }
+        items[ j ] = item;
+        moveCount += i - j;
+        if ( moveCount > maxMoveCount ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::radixSort( std::vector< SortItem >& items, std::vector< SortItem >& itemsTmp )
+{
+    // Histograms of all eight key bytes in one pass
+    static const u64 RADIX_PASS_COUNT = 8;
+    u64 offsets[ RADIX_PASS_COUNT ][ 256 ];
+    memset( offsets, 0, sizeof( offsets ) );
+    for ( const SortItem& item : items ) {
+        for ( u64 pass = 0; pass < RADIX_PASS_COUNT; ++pass ) {
+            ++offsets[ pass ][ ( item.key >> ( pass * 8 ) ) & 0xff ];
+        }
+    }
+
+    itemsTmp.resize( items.size() );
+    for ( u64 pass = 0; pass < RADIX_PASS_COUNT; ++pass ) {
+        // Skip bytes all keys agree on (e.g. upper bytes of small keys)
+        u64 shift = pass * 8;
+        if ( offsets[ pass ][ ( items[ 0 ].key >> shift ) & 0xff ] == items.size() ) {
+            continue;
+        }
+        u64 offset = 0;
+        for ( u64& bucketOffset : offsets[ pass ] ) {
+            u64 bucketCount = bucketOffset;
+            bucketOffset    = offset;
+            offset += bucketCount;
+        }
+        for ( const SortItem& item : items ) {
+            itemsTmp[ offsets[ pass ][ ( item.key >> shift ) & 0xff ]++ ] = item;
+        }
+        items.swap( itemsTmp );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::destroyDeferred( u64 objectHandle )
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( isHandleValid( objectHandle ) );
+
+    Type& type   = m_types[ objectHandleTypeId( objectHandle ) ];
+    u32 objectId = objectHandleObjectId( objectHandle );
+
+    // Invalidate handle right away (also handles reconstructed through 'handleFromState()')
+    u64& lifecycle = type.lifecycleByObjectId[ objectId ];
+    ++lifecycle;
+    lifecycle |= LIFECYCLE_DESTROY_PENDING;
+    ++type.layoutVersion;
+    type.relationsDirty = true;
+    journalDestroy( type, objectHandle );
+
+    if ( type.pendingDestroyObjectIds.empty() ) {
+        m_typeIdsWithPendingDestroys.push_back( type.id );
+    }
+    type.pendingDestroyObjectIds.push_back( objectId );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::flushDestroys()
+{
+    assertNoParallelFor();
+    // Cascading relations destroy further objects (deferred) ==> flush until nothing is pending
+    do {
+        for ( u64 typeId : m_typeIdsWithPendingDestroys ) {
+            flushDestroys( m_types[ typeId ] );
+        }
+        m_typeIdsWithPendingDestroys.clear();
+        applyRelations();
+    } while ( !m_typeIdsWithPendingDestroys.empty() );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::flushDestroys( Type& type )
+{
+    // Translate to indices only now as immediate destruction might have moved objects meanwhile
+    std::vector< u64 > idxsToDestroy;
+    idxsToDestroy.reserve( type.pendingDestroyObjectIds.size() );
+    for ( u64 objectId : type.pendingDestroyObjectIds ) {
+        idxsToDestroy.push_back( type.objectIdToIdx[ objectId ] );
+    }
+    type.pendingDestroyObjectIds.clear();
+    std::sort( idxsToDestroy.begin(), idxsToDestroy.end() );
+
+    COMMON_ASSERT( idxsToDestroy.size() <= type.objectCount );
+    u64 objectCount = type.objectCount - idxsToDestroy.size();
+
+    // Fill holes below the new object count with surviving objects from the tail (skipping
+    // pending objects located in the tail themselves)
+    std::vector< std::pair< u64, u64 > > moves;
+    u64 idxToSwapIn      = type.objectCount;
+    u64 tailPendingCount = idxsToDestroy.size();
+    for ( u64 idxToDestroy : idxsToDestroy ) {
+        if ( idxToDestroy > objectCount ) {
+            break;
+        }
+        while ( tailPendingCount > 0 && idxsToDestroy[ tailPendingCount - 1 ] == idxToSwapIn ) {
+            --tailPendingCount;
+            --idxToSwapIn;
+        }
+        COMMON_ASSERT( idxToSwapIn > objectCount );
+        moves.push_back( std::make_pair( idxToDestroy, idxToSwapIn-- ) );
+    }
+
+    for ( u64 stateId : type.stateIds ) {
+        StateData& state = m_stateData[ stateId ];
+        for ( auto& move : moves ) {
+            memcpy(
+                state.values + state.elemSize * move.first, state.values + state.elemSize * move.second,
+                state.elemSize );
+        }
+        // Reset whole vacated tail at once
+        resetElems( stateId, objectCount + 1, type.objectCount - objectCount );
+    }
+    for ( auto& move : moves ) {
+        markObjectsDirty( type, move.first, 1 );
+    }
+
+    for ( auto& move : moves ) {
+        u64 objectIdToDestroy = type.idxToObjectId[ move.first ];
+        u64 objectIdToSwapIn  = type.idxToObjectId[ move.second ];
+        std::swap( type.objectIdToIdx[ objectIdToSwapIn ], type.objectIdToIdx[ objectIdToDestroy ] );
+        std::swap( type.idxToObjectId[ move.second ], type.idxToObjectId[ move.first ] );
+    }
+
+    // All destroyed objects are located in the vacated tail now ==> make their IDs reusable
+    for ( u64 idx = objectCount + 1; idx <= type.objectCount; ++idx ) {
+        type.lifecycleByObjectId[ type.idxToObjectId[ idx ] ] &= ~LIFECYCLE_DESTROY_PENDING;
+    }
+
+    type.objectCount = objectCount;
+    updateObjectCount( type );
+    ++type.layoutVersion;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::registerRelation(
+    u64 stateId, const std::string& fieldName, u64 targetTypeId, RelationAction onDestroy )
+{
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    COMMON_ASSERT( isTypeIdValid( targetTypeId ) );
+    const State& state = m_states[ stateId ];
+    auto field         = std::find_if(
+        state.fields.begin(), state.fields.end(),
+        [&]( const Field& candidate ) { return candidate.name == fieldName; } );
+    if ( field == state.fields.end() ) {
+        Logger::debug(
+            "ERROR: Unknown relation field \"%s\" of \"%s\"", fieldName.c_str(), state.name.c_str() );
+        COMMON_ASSERT( false );
+        return;
+    }
+    COMMON_ASSERT( field->type == Field::Type::HANDLE && field->count == 1 );
+
+    Relation relation;
+    relation.stateId      = stateId;
+    relation.offsetInB    = field->offsetInB;
+    relation.targetTypeId = targetTypeId;
+    relation.onDestroy    = onDestroy;
+    if ( state.flags & StateFlag::SPLIT ) {
+        relation.stateId   = state.columnStateIds[ field - state.fields.begin() ];
+        relation.offsetInB = 0;
+    }
+    for ( const Relation& existingRelation : m_relations ) {
+        if ( existingRelation.stateId == relation.stateId
+             && existingRelation.offsetInB == relation.offsetInB ) {
+            COMMON_ASSERT( existingRelation.targetTypeId == targetTypeId );
+            COMMON_ASSERT( existingRelation.onDestroy == u64( onDestroy ) );
+            return;
+        }
+    }
+    m_relations.push_back( relation );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::applyRelations()
+{
+    // Only relations to types with destroyed objects have to be checked
+    m_relationTypeIds.clear();
+    for ( const Relation& relation : m_relations ) {
+        const Type& targetType = m_types[ relation.targetTypeId ];
+        if ( targetType.relationsDirty ) {
+            m_relationTypeIds.push_back( relation.targetTypeId );
+        }
+    }
+    for ( u64 typeId : m_relationTypeIds ) {
+        m_types[ typeId ].relationsDirty = false;
+    }
+    if ( m_relationTypeIds.empty() ) {
+        return;
+    }
+
+    for ( const Relation& relation : m_relations ) {
+        if ( std::find( m_relationTypeIds.begin(), m_relationTypeIds.end(), relation.targetTypeId )
+            == m_relationTypeIds.end() ) {
+            continue;
+        }
+        const Type& targetType = m_types[ relation.targetTypeId ];
+        const StateData& data  = m_stateData[ relation.stateId ];
+        const Type& type       = m_types[ data.typeId ];
+        for ( u64 idx = 1; idx <= data.objectCount; ++idx ) {
+            u64& targetHandle = *(u64*)( data.values + data.elemSize * idx + relation.offsetInB );
+            if ( !targetHandle ) {
+                continue;
+            }
+            // Handles of destroyed objects (also pending ones) do not match lifecycle anymore
+            u32 targetObjectId = objectHandleObjectId( targetHandle );
+            u64 lifecycle      = objectHandleLifecycle( targetHandle );
+            if ( objectHandleTypeId( targetHandle ) == targetType.id && targetObjectId >= 1
+                 && targetObjectId <= targetType.objectCapacity
+                 && targetType.lifecycleByObjectId[ targetObjectId ] == lifecycle ) {
+                continue;
+            }
+
+            if ( relation.onDestroy == CASCADE ) {
+                u64 objectId = type.idxToObjectId[ idx ];
+                // Objects already pending destruction (e.g. through earlier relation) are skipped
+                if ( !( type.lifecycleByObjectId[ objectId ] & LIFECYCLE_DESTROY_PENDING ) ) {
+                    destroyDeferred( composeObjectHandle(
+                        u16( type.id ), u16( type.lifecycleByObjectId[ objectId ] ), u32( objectId ) ) );
+                }
+            }
+            else {
+                targetHandle = 0;
+                markDirty( data, idx );
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::TypeStats StateDb::typeStats( u64 typeId )
+{
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    const Type& type = m_types[ typeId ];
+
+    TypeStats stats;
+    stats.objectCount     = type.objectCount;
+    stats.peakObjectCount = type.peakObjectCount;
+    stats.objectCapacity  = type.objectCapacity;
+    stats.maxObjectCount  = type.maxObjectCount;
+    stats.pageObjectCount = type.pageObjectCount;
+    stats.pageCount       = ( type.objectCapacity + type.pageObjectCount - 1 ) / type.pageObjectCount;
+    for ( u64 stateId : type.stateIds ) {
+        const State& state = m_states[ stateId ];
+        stats.usedInB += state.elemSize * type.objectCount;
+        stats.committedInB += state.committedInB;
+        stats.reservedInB += state.reservedInB;
+    }
+    return stats;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::registerChangeConsumer( u64 stateId )
+{
+    // Consumer list must not change while loops might be marking elements dirty
+    assertNoParallelFor();
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    ChangeTracking* changes = m_states[ stateId ].changes.get();
+    COMMON_ASSERT( changes );
+
+    std::unique_ptr< std::atomic< u64 >[] > dirtyWords( new std::atomic< u64 >[ changes->wordCount ] );
+    for ( u64 wordIdx = 0; wordIdx < changes->wordCount; ++wordIdx ) {
+        dirtyWords[ wordIdx ].store( 0, std::memory_order_relaxed );
+    }
+    // Consumer has not seen any of the existing elements yet
+    u64 objectCount = m_stateData[ stateId ].objectCount;
+    for ( u64 idx = 1; idx <= objectCount; ++idx ) {
+        dirtyWords[ idx / 64 ].fetch_or( 1ull << ( idx % 64 ), std::memory_order_relaxed );
+    }
+
+    changes->dirtyWordsByConsumer.push_back( std::move( dirtyWords ) );
+    return changes->dirtyWordsByConsumer.size() - 1;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::stateVersion( u64 stateId )
+{
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    const ChangeTracking* changes = m_states[ stateId ].changes.get();
+    COMMON_ASSERT( changes );
+    return changes->version.load( std::memory_order_relaxed );
+}
+
+// -------------------------------------------------------------------------------------------------
+const std::vector< u32 >& StateDb::selectTagged( u64 tagStateId, u64 allMask, u64 anyMask, u64 noneMask )
+{
+    COMMON_ASSERT( isStateIdValid( tagStateId ) );
+    const StateData& data = m_stateData[ tagStateId ];
+    // Change tracking tells when cached selections become stale
+    COMMON_ASSERT( data.elemSize == sizeof( u64 ) && data.changes );
+    const Type& type = m_types[ data.typeId ];
+
+    TagSelection& selection = m_tagSelections[ std::make_tuple( tagStateId, allMask, anyMask, noneMask ) ];
+    u64 stateVersion        = data.changes->version.load( std::memory_order_relaxed );
+    if ( selection.valid && selection.stateVersion == stateVersion
+         && selection.layoutVersion == type.layoutVersion && selection.objectCount == type.objectCount ) {
+        return selection.idxs;
+    }
+
+    selection.idxs.clear();
+    selectTags( (const u64*)data.values + 1, type.objectCount, allMask, anyMask, noneMask, selection.idxs );
+    selection.stateVersion  = stateVersion;
+    selection.layoutVersion = type.layoutVersion;
+    selection.objectCount   = type.objectCount;
+    selection.valid         = true;
+    return selection.idxs;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::registerLifecycleCursor( u64 typeId )
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( isTypeIdValid( typeId ) );
+    Type& type       = m_types[ typeId ];
+    Journal& journal = type.journal;
+
+    std::vector< u64 > initialHandles( type.objectCount );
+    for ( u64 idx = 1; idx <= type.objectCount; ++idx ) {
+        u64 objectId              = type.idxToObjectId[ idx ];
+        u64 lifecycle             = type.lifecycleByObjectId[ objectId ];
+        initialHandles[ idx - 1 ] = composeObjectHandle( u16( typeId ), u16( lifecycle ), u32( objectId ) );
+    }
+    journal.cursorSeqs.push_back( journal.firstSeq + journal.events.size() );
+    journal.initialHandlesByCursor.push_back( std::move( initialHandles ) );
+    return journal.cursorSeqs.size() - 1;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::journalCreates( Type& type, u64 firstIdx, u64 count )
+{
+    if ( type.journal.cursorSeqs.empty() ) {
+        return;
+    }
+    for ( u64 idx = firstIdx; idx < firstIdx + count; ++idx ) {
+        u64 objectId         = type.idxToObjectId[ idx ];
+        u64 lifecycle        = type.lifecycleByObjectId[ objectId ];
+        LifecycleEvent event = { composeObjectHandle( u16( type.id ), u16( lifecycle ), u32( objectId ) ),
+                                 LifecycleEvent::CREATED };
+        type.journal.events.push_back( event );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::journalDestroy( Type& type, u64 objectHandle )
+{
+    if ( type.journal.cursorSeqs.empty() ) {
+        return;
+    }
+    LifecycleEvent event = { objectHandle, LifecycleEvent::DESTROYED };
+    type.journal.events.push_back( event );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::trimJournal( Journal& journal )
+{
+    u64 endSeq = journal.firstSeq + journal.events.size();
+    for ( u64 cursorSeq : journal.cursorSeqs ) {
+        if ( cursorSeq != endSeq ) {
+            return;
+        }
+    }
+    // Keeps capacity ==> steady state does not allocate
+    journal.events.clear();
+    journal.firstSeq = endSeq;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::saveImage( const std::string& filename )
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( m_typeIdsWithPendingDestroys.empty() );
+
+    std::ofstream out( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !out ) {
+        Logger::debug( "ERROR: Failed to open state database image \"%s\"", filename.c_str() );
+        return false;
+    }
+
+    ImageHeader header;
+    memcpy( header.magic, IMAGE_MAGIC, sizeof( header.magic ) );
+    header.formatVersion = IMAGE_FORMAT_VERSION;
+    header.schemaHash    = schemaHash();
+    header.typeCount     = m_types.size() - 1;
+    header.stateCount    = m_states.size() - 1;
+    out.write( (const char*)&header, sizeof( header ) );
+
+    for ( u64 typeId = 1; typeId < m_types.size(); ++typeId ) {
+        const Type& type = m_types[ typeId ];
+
+        ImageType imageType;
+        imageType.schemaHash      = type.schemaHash;
+        imageType.objectCount     = type.objectCount;
+        imageType.peakObjectCount = type.peakObjectCount;
+        imageType.objectCapacity  = type.objectCapacity;
+        out.write( (const char*)&imageType, sizeof( imageType ) );
+
+        u64 mapSizeInB = ( type.objectCapacity + 1 ) * sizeof( u64 );
+        out.write( (const char*)&type.objectIdToIdx[ 0 ], mapSizeInB );
+        out.write( (const char*)&type.idxToObjectId[ 0 ], mapSizeInB );
+        out.write( (const char*)&type.lifecycleByObjectId[ 0 ], mapSizeInB );
+    }
+
+    const u64 padding = 0;
+    for ( u64 stateId = 1; stateId < m_states.size(); ++stateId ) {
+        const State& state    = m_states[ stateId ];
+        const StateData& data = m_stateData[ stateId ];
+
+        ImageState imageState;
+        imageState.schemaHash    = state.schemaHash;
+        imageState.valuesSizeInB = 0;
+        if ( isStored( state ) ) {
+            // Includes null element ==> one contiguous copy on load
+            imageState.valuesSizeInB = ( data.objectCount + 1 ) * data.elemSize;
+        }
+        out.write( (const char*)&imageState, sizeof( imageState ) );
+        out.write( (const char*)data.values, imageState.valuesSizeInB );
+        out.write( (const char*)&padding, ( 8 - imageState.valuesSizeInB % 8 ) % 8 );
+    }
+
+    out.close();
+    if ( !out ) {
+        Logger::debug( "ERROR: Failed to write state database image \"%s\"", filename.c_str() );
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::loadImage( const std::string& filename )
+{
+    assertNoParallelFor();
+    for ( const Type& type : m_types ) {
+        if ( type.objectCount > 0 ) {
+            Logger::debug( "ERROR: State database has to be empty for loading image" );
+            return false;
+        }
+    }
+
+    u64 imageSizeInB           = 0;
+    const unsigned char* image = (const unsigned char*)Platform::mapFile( filename, imageSizeInB );
+    if ( !image ) {
+        Logger::debug( "ERROR: Failed to map state database image \"%s\"", filename.c_str() );
+        return false;
+    }
+
+    // Validate whole image up front so that a bad image does not leave us half loaded
+    std::vector< const ImageType* > imageTypes( m_types.size(), nullptr );
+    std::vector< const ImageState* > imageStates( m_states.size(), nullptr );
+    if ( !validateImage( image, imageSizeInB, imageTypes, imageStates ) ) {
+        Logger::debug( "ERROR: Rejected state database image \"%s\"", filename.c_str() );
+        Platform::unmapFile( image, imageSizeInB );
+        return false;
+    }
+
+    bool loaded = true;
+    for ( u64 typeId = 1; loaded && typeId < m_types.size(); ++typeId ) {
+        Type& type                 = m_types[ typeId ];
+        const ImageType* imageType = imageTypes[ typeId ];
+        while ( loaded && type.objectCapacity < imageType->objectCapacity ) {
+            loaded = growType( type );
+        }
+        if ( !loaded ) {
+            Logger::debug( "ERROR: Out of memory for type \"%s\" loading image", type.name.c_str() );
+            break;
+        }
+
+        u64 mapCount   = imageType->objectCapacity + 1;
+        const u64* map = (const u64*)( imageType + 1 );
+        std::copy( map, map + mapCount, type.objectIdToIdx.begin() );
+        std::copy( map + mapCount, map + 2 * mapCount, type.idxToObjectId.begin() );
+        std::copy( map + 2 * mapCount, map + 3 * mapCount, type.lifecycleByObjectId.begin() );
+        // Capacity beyond image might have been permuted by earlier use ==> restore identity mapping
+        for ( u64 id = mapCount; id < type.objectCapacity + 1; ++id ) {
+            type.objectIdToIdx[ id ] = id;
+            type.idxToObjectId[ id ] = id;
+        }
+
+        type.objectCount     = imageType->objectCount;
+        type.peakObjectCount = std::max( type.peakObjectCount, imageType->peakObjectCount );
+        ++type.layoutVersion;
+        updateObjectCount( type );
+    }
+
+    // Unused elements hold default values already (database was empty) ==> only copy values
+    for ( u64 stateId = 1; loaded && stateId < m_states.size(); ++stateId ) {
+        const ImageState* imageState = imageStates[ stateId ];
+        if ( imageState->valuesSizeInB ) {
+            memcpy( m_stateData[ stateId ].values, imageState + 1, imageState->valuesSizeInB );
+        }
+    }
+    for ( u64 typeId = 1; loaded && typeId < m_types.size(); ++typeId ) {
+        markObjectsDirty( m_types[ typeId ], 1, m_types[ typeId ].objectCount );
+        journalCreates( m_types[ typeId ], 1, m_types[ typeId ].objectCount );
+    }
+
+    Platform::unmapFile( image, imageSizeInB );
+    return loaded;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::validateImage(
+    const unsigned char* image, u64 imageSizeInB, std::vector< const ImageType* >& imageTypes,
+    std::vector< const ImageState* >& imageStates )
+{
+    const ImageHeader* header = (const ImageHeader*)image;
+    if ( imageSizeInB < sizeof( ImageHeader )
+         || memcmp( header->magic, IMAGE_MAGIC, sizeof( IMAGE_MAGIC ) ) != 0
+         || header->formatVersion != IMAGE_FORMAT_VERSION ) {
+        Logger::debug( "ERROR: Unknown state database image format" );
+        return false;
+    }
+    if ( header->typeCount != m_types.size() - 1 || header->stateCount != m_states.size() - 1 ) {
+        Logger::debug( "ERROR: State database image has different number of types/states" );
+        return false;
+    }
+
+    u64 offsetInB = sizeof( ImageHeader );
+    for ( u64 typeId = 1; typeId < m_types.size(); ++typeId ) {
+        const Type& type = m_types[ typeId ];
+        if ( offsetInB + sizeof( ImageType ) > imageSizeInB ) {
+            Logger::debug( "ERROR: State database image is truncated" );
+            return false;
+        }
+        const ImageType* imageType = (const ImageType*)( image + offsetInB );
+        if ( imageType->schemaHash != type.schemaHash || imageType->objectCapacity > type.maxObjectCount
+             || imageType->objectCount > imageType->objectCapacity ) {
+            Logger::debug( "ERROR: Type \"%s\" does not match state database image", type.name.c_str() );
+            return false;
+        }
+        imageTypes[ typeId ] = imageType;
+        offsetInB += sizeof( ImageType ) + 3 * ( imageType->objectCapacity + 1 ) * sizeof( u64 );
+    }
+
+    for ( u64 stateId = 1; stateId < m_states.size(); ++stateId ) {
+        const State& state = m_states[ stateId ];
+        if ( offsetInB + sizeof( ImageState ) > imageSizeInB ) {
+            Logger::debug( "ERROR: State database image is truncated" );
+            return false;
+        }
+        const ImageState* imageState = (const ImageState*)( image + offsetInB );
+        u64 valuesSizeInB            = 0;
+        if ( isStored( state ) ) {
+            valuesSizeInB = ( imageTypes[ state.typeId ]->objectCount + 1 ) * state.elemSize;
+        }
+        if ( imageState->schemaHash != state.schemaHash || imageState->valuesSizeInB != valuesSizeInB ) {
+            Logger::debug( "ERROR: State \"%s\" does not match state database image", state.name.c_str() );
+            return false;
+        }
+        imageStates[ stateId ] = imageState;
+        offsetInB += sizeof( ImageState ) + ( valuesSizeInB + 7 ) / 8 * 8;
+    }
+
+    if ( offsetInB > imageSizeInB ) {
+        Logger::debug( "ERROR: State database image is truncated" );
+        return false;
+    }
+    // Records match one by one ==> this only fails if ordering of types/states changed
+    if ( header->schemaHash != schemaHash() ) {
+        Logger::debug( "ERROR: State database image schema does not match" );
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::schemaHash()
+{
+    u64 hash = hashBytes( nullptr, 0 );
+    for ( u64 typeId = 1; typeId < m_types.size(); ++typeId ) {
+        hash = hashBytes( &m_types[ typeId ].schemaHash, sizeof( u64 ), hash );
+    }
+    for ( u64 stateId = 1; stateId < m_states.size(); ++stateId ) {
+        hash = hashBytes( &m_states[ stateId ].schemaHash, sizeof( u64 ), hash );
+    }
+    return hash;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::hashFields( const std::vector< Field >& fields, u64 hash )
+{
+    for ( const Field& field : fields ) {
+        u64 type = u64( field.type );
+        hash     = hashBytes( field.name.data(), field.name.length(), hash );
+        hash     = hashBytes( &type, sizeof( u64 ), hash );
+        hash     = hashBytes( &field.count, sizeof( u64 ), hash );
+        hash     = hashBytes( &field.offsetInB, sizeof( u64 ), hash );
+    }
+    return hash;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::hashBytes( const void* bytes, u64 sizeInB, u64 hash )
+{
+    // 64 bit FNV-1a
+    const unsigned char* byte = (const unsigned char*)bytes;
+    for ( u64 byteIdx = 0; byteIdx < sizeInB; ++byteIdx ) {
+        hash ^= byte[ byteIdx ];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::addSnapshotState( u64 stateId )
+{
+    COMMON_ASSERT( isStateIdValid( stateId ) );
+    // TODO(martinmo): Support 'SPLIT' states (copy columns and add column access to snapshots)
+    COMMON_ASSERT( !( m_states[ stateId ].flags & StateFlag::SPLIT ) );
+    if ( std::find( m_snapshotStateIds.begin(), m_snapshotStateIds.end(), stateId )
+        != m_snapshotStateIds.end() ) {
+        return;
+    }
+    m_snapshotStateIds.push_back( stateId );
+
+    u64 typeId = m_states[ stateId ].typeId;
+    if ( std::find( m_snapshotTypeIds.begin(), m_snapshotTypeIds.end(), typeId )
+        == m_snapshotTypeIds.end() ) {
+        m_snapshotTypeIds.push_back( typeId );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::publishSnapshot()
+{
+    if ( m_snapshotStateIds.empty() ) {
+        return;
+    }
+    assertNoParallelFor();
+
+    // Buffers are reused ==> no allocations once they have reached their peak sizes
+    Snapshot& snapshot = m_snapshots[ m_snapshotWriteIdx ];
+    snapshot.frame     = ++m_snapshotFrame;
+    snapshot.types.resize( m_types.size() );
+    snapshot.states.resize( m_states.size() );
+    for ( u64 typeId : m_snapshotTypeIds ) {
+        const Type& type         = m_types[ typeId ];
+        Snapshot::TypeCopy& copy = snapshot.types[ typeId ];
+        copy.objectCount         = type.objectCount;
+        copy.objectIdToIdx.assign( type.objectIdToIdx.begin(), type.objectIdToIdx.end() );
+        copy.lifecycleByObjectId.assign( type.lifecycleByObjectId.begin(), type.lifecycleByObjectId.end() );
+    }
+    for ( u64 stateId : m_snapshotStateIds ) {
+        const StateData& data     = m_stateData[ stateId ];
+        Snapshot::StateCopy& copy = snapshot.states[ stateId ];
+        copy.typeId               = data.typeId;
+        copy.elemSize             = data.elemSize;
+        copy.values.assign( data.values, data.values + ( data.objectCount + 1 ) * data.elemSize );
+    }
+
+    // Hand over snapshot and continue with whichever buffer the reader is not holding
+    u64 prevSharedIdx  = m_snapshotSharedIdx.exchange( m_snapshotWriteIdx | SNAPSHOT_FRESH );
+    m_snapshotWriteIdx = prevSharedIdx & ~SNAPSHOT_FRESH;
+}
+
+// -------------------------------------------------------------------------------------------------
+const StateDb::Snapshot* StateDb::acquireSnapshot()
+{
+    if ( m_snapshotSharedIdx.load() & SNAPSHOT_FRESH ) {
+        u64 prevSharedIdx = m_snapshotSharedIdx.exchange( m_snapshotReadIdx );
+        m_snapshotReadIdx = prevSharedIdx & ~SNAPSHOT_FRESH;
+    }
+    const Snapshot& snapshot = m_snapshots[ m_snapshotReadIdx ];
+    return snapshot.frame ? &snapshot : nullptr;
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::ForkBase::~ForkBase()
+{
+    // Forks keep their mappings of the file
+    if ( arenaFile ) {
+        Platform::closeMemoryFile( arenaFile );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::publishForkBase()
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( m_typeIdsWithPendingDestroys.empty() );
+    COMMON_ASSERT( m_creatorCount.load() == 0 );
+    {
+        std::lock_guard< std::mutex > lock( m_submittedCommandsMutex );
+        COMMON_ASSERT( m_submittedCommands.empty() );
+    }
+
+    // State regions keep their offsets into the arena (forks commit the same ranges)
+    std::shared_ptr< ForkBase > base = std::make_shared< ForkBase >();
+    base->arenaSizeInB               = m_arenaUsedInB;
+    base->arenaFile                  = Platform::createMemoryFile( base->arenaSizeInB );
+    if ( !base->arenaFile ) {
+        Logger::debug( "WARNING: Failed to create memory file for fork base" );
+        return false;
+    }
+    for ( const State& state : m_states ) {
+        if ( !state.committedInB ) {
+            continue;
+        }
+        u64 offsetInB = u64( state.memory - m_arena );
+        if ( !Platform::writeMemoryFile( base->arenaFile, offsetInB, state.memory, state.committedInB ) ) {
+            Logger::debug( "ERROR: Failed to copy state \"%s\" into fork base", state.name.c_str() );
+            return false;
+        }
+    }
+
+    base->flags          = m_flags;
+    base->memoryPageSize = m_memoryPageSize;
+    base->arena          = m_arena;
+    base->typeIdsByName  = m_typeIdsByName;
+    base->types          = m_types;
+    for ( Type& type : base->types ) {
+        // Forks get reservations of their own
+        type.reservations = nullptr;
+    }
+    base->stateIdsByName = m_stateIdsByName;
+    base->states         = m_states;
+    base->relations      = m_relations;
+    for ( State& state : base->states ) {
+        // Dirty bits as of now (consumers continue to consume changes of this database)
+        if ( state.changes ) {
+            state.changes = copyChangeTracking( *state.changes );
+        }
+    }
+
+    std::lock_guard< std::mutex > lock( m_forkBaseMutex );
+    m_forkBase = base;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+std::unique_ptr< StateDb > StateDb::fork()
+{
+    std::shared_ptr< const ForkBase > base;
+    {
+        std::lock_guard< std::mutex > lock( m_forkBaseMutex );
+        base = m_forkBase;
+    }
+    if ( !base ) {
+        return nullptr;
+    }
+    std::unique_ptr< StateDb > forked( new StateDb( *base ) );
+    if ( !forked->m_arena ) {
+        return nullptr;
+    }
+    return forked;
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDb::StateDb( const ForkBase& base )
+    : m_reservedObjectCount( 0 )
+    , m_creatorCount( 0 )
+    , m_flags( base.flags )
+    , m_snapshotSharedIdx( 2 )
+    , m_parallelForDepth( 0 )
+{
+    m_fork           = true;
+    m_memoryPageSize = base.memoryPageSize;
+    // Arena ends with last state region ==> forks cannot register further states
+    m_arenaSizeInB = base.arenaSizeInB;
+    m_arenaUsedInB = base.arenaSizeInB;
+    m_arena        = (unsigned char*)Platform::mapMemoryFileCopyOnWrite( base.arenaFile, m_arenaSizeInB );
+    if ( !m_arena ) {
+        Logger::debug( "ERROR: Failed to map fork base" );
+        return;
+    }
+
+    m_typeIdsByName = base.typeIdsByName;
+    m_types         = base.types;
+    for ( Type& type : m_types ) {
+        if ( type.id ) {
+            type.reservations = std::make_shared< Reservations >();
+        }
+    }
+
+    m_stateIdsByName = base.stateIdsByName;
+    m_states         = base.states;
+    m_relations      = base.relations;
+    m_stateData.resize( m_states.size() );
+    for ( State& state : m_states ) {
+        if ( state.changes ) {
+            state.changes = copyChangeTracking( *state.changes );
+        }
+        StateData& data = m_stateData[ state.id ];
+        data.elemSize   = state.elemSize;
+        data.typeId     = state.typeId;
+        data.changes    = state.changes.get();
+        // Null state and 'SPLIT' states have no memory
+        if ( !state.memory ) {
+            continue;
+        }
+
+        state.memory = m_arena + ( state.memory - base.arena );
+        if ( state.committedInB && !Platform::commitMemory( state.memory, state.committedInB ) ) {
+            Logger::debug( "ERROR: Failed to commit memory for state \"%s\"", state.name.c_str() );
+            COMMON_ASSERT( false );
+        }
+        const Type& type         = m_types[ state.typeId ];
+        data.values              = state.memory + state.valuesOffsetInB;
+        data.objectIdToIdx       = &type.objectIdToIdx[ 0 ];
+        data.lifecycleByObjectId = &type.lifecycleByObjectId[ 0 ];
+        data.objectCount         = type.objectCount;
+        data.objectCapacity      = type.objectCapacity;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+std::shared_ptr< StateDb::ChangeTracking > StateDb::copyChangeTracking( const ChangeTracking& changes )
+{
+    std::shared_ptr< ChangeTracking > copy = std::make_shared< ChangeTracking >();
+    copy->version.store( changes.version.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+    copy->wordCount = changes.wordCount;
+    for ( const auto& dirtyWords : changes.dirtyWordsByConsumer ) {
+        std::unique_ptr< std::atomic< u64 >[] > dirtyWordsCopy( new std::atomic< u64 >[ changes.wordCount ] );
+        for ( u64 wordIdx = 0; wordIdx < changes.wordCount; ++wordIdx ) {
+            u64 word = dirtyWords[ wordIdx ].load( std::memory_order_relaxed );
+            dirtyWordsCopy[ wordIdx ].store( word, std::memory_order_relaxed );
+        }
+        copy->dirtyWordsByConsumer.push_back( std::move( dirtyWordsCopy ) );
+    }
+    return copy;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::setJobSystem( JobSystem* jobSystem )
+{
+    m_jobSystem = jobSystem;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::parallelFor( u64 count, u64 grain, const std::function< void( u64, u64 ) >& func )
+{
+    // Nested loops run inside chunks (on workers) ==> only the thread that started the outermost
+    // loop sees depth 0 and this happens after all chunks (including nested loops) returned
+    bool outermost = m_parallelForDepth.fetch_add( 1 ) == 0;
+    if ( m_jobSystem ) {
+        m_jobSystem->parallelFor( count, grain, func );
+    }
+    else if ( count ) {
+        func( 0, count );
+    }
+    m_parallelForDepth.fetch_sub( 1 );
+
+    // Loop is the sync point for objects created and commands recorded by its chunks
+    if ( outermost ) {
+        playbackCommands();
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::assertNoParallelFor()
+{
+#ifdef COMMON_DEBUG
+    // Structural changes would invalidate views of loops running in parallel
+    COMMON_ASSERT( m_parallelForDepth.load( std::memory_order_relaxed ) == 0 );
+    // ... and collide with slots reserved by creators
+    COMMON_ASSERT( m_reservedObjectCount.load( std::memory_order_relaxed ) == 0 );
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::createObjects( Type& type, u64 count, u64* createdObjectHandles )
+{
+    assertNoParallelFor();
+    COMMON_ASSERT( count > 0 );
+    while ( type.objectCount + count > type.objectCapacity ) {
+        if ( !growType( type ) ) {
+            Logger::debug( "WARNING: Out of memory for type \"%s\"", type.name.c_str() );
+            if ( createdObjectHandles ) {
+                std::fill( createdObjectHandles, createdObjectHandles + count, 0 );
+            }
+            return 0;
+        }
+    }
+
+    // Unused elements always hold default values ==> no need to touch state memory here
+    u64 firstIdx = type.objectCount + 1;
+    for ( u64 idx = firstIdx; idx < firstIdx + count; ++idx ) {
+        u64 objectId   = type.idxToObjectId[ idx ];
+        u64& lifecycle = type.lifecycleByObjectId[ objectId ];
+        ++lifecycle;
+        if ( createdObjectHandles ) {
+            createdObjectHandles[ idx - firstIdx ] =
+                composeObjectHandle( u16( type.id ), u16( lifecycle ), u32( objectId ) );
+        }
+    }
+    type.objectCount += count;
+    updateObjectCount( type );
+    markObjectsDirty( type, firstIdx, count );
+    journalCreates( type, firstIdx, count );
+
+    return firstIdx;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::resetElems( u64 stateId, u64 firstIdx, u64 count )
+{
+    const State& state = m_states[ stateId ];
+    unsigned char* elems = m_stateData[ stateId ].values + state.elemSize * firstIdx;
+    if ( state.defaultElem.empty() ) {
+        memset( elems, 0, state.elemSize * count );
+    }
+    else {
+        fillElems( elems, &state.defaultElem[ 0 ], count, state.elemSize );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::markObjectsDirty( const Type& type, u64 firstIdx, u64 count )
+{
+    for ( u64 stateId : type.stateIds ) {
+        const StateData& data = m_stateData[ stateId ];
+        if ( !data.changes ) {
+            continue;
+        }
+        for ( u64 idx = firstIdx; idx < firstIdx + count; ++idx ) {
+            markDirty( data, idx );
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::fillElems( void* elems, const void* elem, u64 count, u64 elemSize )
+{
+    if ( !count ) {
+        return;
+    }
+    // Copy first element and then keep doubling the initialized range (few wide copies)
+    unsigned char* bytes = (unsigned char*)elems;
+    memcpy( bytes, elem, elemSize );
+    for ( u64 filled = 1; filled < count; filled *= 2 ) {
+        memcpy( bytes + filled * elemSize, bytes, std::min( filled, count - filled ) * elemSize );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDb::updateObjectCount( Type& type )
+{
+    for ( u64 stateId : type.stateIds ) {
+        m_stateData[ stateId ].objectCount = type.objectCount;
+    }
+    if ( type.objectCount > type.peakObjectCount ) {
+        type.peakObjectCount = type.objectCount;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDb::stateSizeInB( const State& state, u64 objectCapacity )
+{
+    // Alignment offset + null element + live elements padded to alignment
+    u64 paddedValuesSizeInB = roundUpToStateAlignment( state.elemSize * objectCapacity );
+    return state.valuesOffsetInB + state.elemSize + paddedValuesSizeInB;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::commitStateMemory( State& state, u64 objectCapacity )
+{
+    u64 requiredInB = stateSizeInB( state, objectCapacity );
+    requiredInB     = ( requiredInB + m_memoryPageSize - 1 ) / m_memoryPageSize * m_memoryPageSize;
+    COMMON_ASSERT( requiredInB <= state.reservedInB );
+    if ( requiredInB <= state.committedInB ) {
+        return true;
+    }
+    if ( !Platform::commitMemory( state.memory + state.committedInB, requiredInB - state.committedInB ) ) {
+        return false;
+    }
+    state.committedInB = requiredInB;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDb::growType( Type& type )
+{
+    if ( !( type.flags & TypeFlag::GROWABLE ) || type.objectCapacity >= type.maxObjectCount ) {
+        return false;
+    }
+
+    u64 objectCapacity = type.objectCapacity + type.pageObjectCount;
+    if ( objectCapacity > type.maxObjectCount ) {
+        objectCapacity = type.maxObjectCount;
+    }
+
+    // Committing more of the reserved address space never moves existing elements
+    for ( u64 stateId : type.stateIds ) {
+        if ( !commitStateMemory( m_states[ stateId ], objectCapacity ) ) {
+            return false;
+        }
+    }
+
+    // Extend ID maps (new object IDs and indices are unused ==> identity mapping)
+    type.lifecycleByObjectId.resize( objectCapacity + 1, 0 );
+    type.objectIdToIdx.resize( objectCapacity + 1, 0 );
+    type.idxToObjectId.resize( objectCapacity + 1, 0 );
+    for ( u64 id = type.objectCapacity + 1; id < objectCapacity + 1; ++id ) {
+        type.objectIdToIdx[ id ] = id;
+        type.idxToObjectId[ id ] = id;
+    }
+
+    // ID maps might have been reallocated ==> update cached pointers
+    for ( u64 stateId : type.stateIds ) {
+        StateData& data          = m_stateData[ stateId ];
+        data.objectIdToIdx       = &type.objectIdToIdx[ 0 ];
+        data.lifecycleByObjectId = &type.lifecycleByObjectId[ 0 ];
+        data.objectCapacity      = objectCapacity;
+        if ( !m_states[ stateId ].defaultElem.empty() ) {
+            resetElems( stateId, type.objectCapacity + 1, objectCapacity - type.objectCapacity );
+        }
+    }
+    type.objectCapacity = objectCapacity;
+
+    return true;
+}
+
 // -------------------------------------------------------------------------------------------------
 u64 StateDb::composeObjectHandle( u16 typeId, u16 lifecycle, u32 objectId )
 {
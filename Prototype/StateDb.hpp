@@ -10,10 +10,24 @@
 
 #include <vector>
 #include <map>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <tuple>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "Logger.hpp"
 
+struct JobSystem;
+
 // -------------------------------------------------------------------------------------------------
 /// @brief State database implementation
 ///
@@ -28,8 +42,111 @@
 /// With this implementation we pay (in terms of run-time) on:
 /// - Object deletion (fill hole by moving in state from end of state vector)
 /// - Object lookup through handle (ID to index translation via per-type vector)
+///
+/// State memory is reserved up front for the maximum object count of a type. Types registered
+/// as 'GROWABLE' only commit memory page by page on demand so they can be registered with large
+/// maximum object counts. Elements never move due to growth so pointers stay valid in between
+/// structural changes (object creation/destruction).
+///
+/// All state arrays are carved out of one arena (single address space reservation) per state
+/// database. The first live element (index 1) of every state array starts on a 64 B boundary and
+/// the array is padded (with zeroes) up to the next multiple of 64 B so that SIMD loops can use
+/// aligned loads/stores without peeling and no element straddles the array boundary.
+///
+/// States registered with 'TRACK_CHANGES' record writes announced through 'stateMut()' or
+/// 'markDirty()' in one dirty bitset per consumer so that consumers only need to visit elements
+/// changed since their last visit ('forEachChanged()').
+///
+/// Selected states can be published as immutable snapshots (copies of the packed arrays plus the
+/// index maps) at the end of simulation. Snapshots are triple-buffered so that a reader (e.g. a
+/// render thread) can consume frame N while simulation writes frame N+1 without any locks.
+///
+/// The whole database can be saved to a binary image and loaded back by mapping the image and
+/// copying tables and arrays as a whole (no per-object work). Images carry a schema hash of all
+/// registered types and states and are rejected if the layout does not match.
+///
+/// Worker threads can create objects concurrently through 'Creator's which reserve blocks of
+/// object slots past the live objects. Such objects become part of state ranges once the
+/// reservations are flushed at the end of 'parallelFor()' (or by calling 'flushCreates()').
+/// 'CommandBuffer's build on them to record destroys and writes as well which are applied in one
+/// batch at the same sync point.
+///
+/// States can be registered with field descriptors (see 'STATEDB_FIELD()') which makes their
+/// members visible to generic tooling. States registered as 'SPLIT' store each field in its own
+/// column (true structure of arrays) so that loops only touch the fields they need.
+///
+/// Objects can be filtered by tag words kept in compact change-tracked states ('selectTagged()')
+/// so that loops over a few matching objects do not need to read the states of all objects.
 struct StateDb
 {
+    /// Alignment of first live element and array tail padding (cache line, >= SIMD register width)
+    static const u64 STATE_ALIGNMENT_IN_B = 64;
+
+    enum Flag
+    {
+        HUGE_PAGES = 0x1  // back arena with (transparent) huge pages if available
+    };
+
+    enum TypeFlag
+    {
+        GROWABLE = 0x1  // commit state memory in pages on demand instead of on registration
+    };
+
+    enum StateFlag
+    {
+        TRACK_CHANGES = 0x1,  // maintain dirty bitsets for change consumers
+        TRANSIENT     = 0x2,  // runtime-only data (pointers, API objects) not stored in images
+        SPLIT         = 0x4   // store fields in separate columns (accessed through 'column()')
+    };
+
+    /// What happens to referencing objects when the object referenced through a relation is destroyed
+    enum RelationAction
+    {
+        NULLIFY = 0,  // set relation field to 0
+        CASCADE = 1   // destroy referencing object as well
+    };
+
+    /// Describes one member of a state element (usually created through 'STATEDB_FIELD()')
+    struct Field
+    {
+        enum Type
+        {
+            U32 = 0,
+            S32,
+            U64,
+            S64,
+            F32,
+            F64,
+            HANDLE  // object handle
+        };
+
+        std::string name;
+        Type type     = Type::F32;  // type of component(s)
+        u64 count     = 1;          // component count
+        u64 offsetInB = 0;          // offset into state element
+
+        /// Member size (if given) has to match type and count (catches out of date descriptors)
+        Field(
+            const std::string& nameInit = "", Type typeInit = Type::F32, u64 countInit = 1,
+            u64 offsetInBInit = 0, u64 memberSizeInB = 0 );
+
+        u64 sizeInB() const;
+    };
+
+    /// Memory occupancy statistics of a type (summed up over all of its states)
+    struct TypeStats
+    {
+        u64 objectCount     = 0;
+        u64 peakObjectCount = 0;
+        u64 objectCapacity  = 0;  // object count backed by committed memory
+        u64 maxObjectCount  = 0;
+        u64 pageObjectCount = 0;  // objects committed per growth step
+        u64 pageCount       = 0;  // growth steps committed so far
+        u64 usedInB         = 0;  // memory used by live objects
+        u64 committedInB    = 0;
+        u64 reservedInB     = 0;
+    };
+
     template< class ElementType >
     struct StateRange
     {
@@ -77,17 +194,456 @@ struct StateDb
         }
     };
 
-    StateDb();
+    /// State range with 'beginElem' aligned to 'STATE_ALIGNMENT_IN_B' and 'paddedSizeInB' bytes
+    /// starting at 'beginElem' being readable/writable (elements past 'endElem' are zero)
+    template< class ElementType >
+    struct AlignedStateRange : public StateRange< ElementType >
+    {
+        u64 paddedSizeInB = 0;
+    };
+
+private:
+    // Compile-time helpers for state views (C++11 lacks 'std::index_sequence')
+    template< u64... Indices >
+    struct IndexSeq
+    {
+    };
+    template< u64 N, u64... Indices >
+    struct MakeIndexSeq : MakeIndexSeq< N - 1, N - 1, Indices... >
+    {
+    };
+    template< u64... Indices >
+    struct MakeIndexSeq< 0, Indices... >
+    {
+        typedef IndexSeq< Indices... > Type;
+    };
+    template< class ElementType, class... ElementTypes >
+    struct ElementIndex;
+    template< class ElementType, class... ElementTypes >
+    struct ElementIndex< ElementType, ElementType, ElementTypes... >
+    {
+        static const u64 VALUE = 0;
+    };
+    template< class ElementType, class OtherElementType, class... ElementTypes >
+    struct ElementIndex< ElementType, OtherElementType, ElementTypes... >
+    {
+        static const u64 VALUE = 1 + ElementIndex< ElementType, ElementTypes... >::VALUE;
+    };
+
+public:
+    /// Joined view on multiple states of the same type (index i refers to the same object in all
+    /// states) dereferencing to a tuple of element pointers
+    ///
+    /// Besides iteration this provides raw per-state arrays ('data()' + 'size()') for loops the
+    /// compiler can vectorize and 'subView()' for splitting work into chunks for parallel loops.
+    /// Like state ranges views are invalidated by structural changes (object creation/destruction).
+    template< class... ElementTypes >
+    struct StateView
+    {
+        typedef std::tuple< ElementTypes*... > Elems;
+
+        struct Iter
+        {
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef Elems value_type;
+            typedef s64 difference_type;
+            typedef const Elems* pointer;
+            typedef Elems reference;
+
+            Iter() = default;
+            Iter( const Elems& beginElems, s64 idx )
+                : m_beginElems( beginElems )
+                , m_idx( idx )
+            {
+            }
+
+            Elems operator*() const
+            {
+                return elemsAt( m_beginElems, u64( m_idx ) );
+            }
+            Elems operator[]( s64 offset ) const
+            {
+                return elemsAt( m_beginElems, u64( m_idx + offset ) );
+            }
+
+            Iter& operator++()
+            {
+                ++m_idx;
+                return *this;
+            }
+            Iter operator++( int )
+            {
+                Iter prev = *this;
+                ++m_idx;
+                return prev;
+            }
+            Iter& operator--()
+            {
+                --m_idx;
+                return *this;
+            }
+            Iter operator--( int )
+            {
+                Iter prev = *this;
+                --m_idx;
+                return prev;
+            }
+            Iter& operator+=( s64 offset )
+            {
+                m_idx += offset;
+                return *this;
+            }
+            Iter& operator-=( s64 offset )
+            {
+                m_idx -= offset;
+                return *this;
+            }
+            Iter operator+( s64 offset ) const
+            {
+                return Iter( m_beginElems, m_idx + offset );
+            }
+            Iter operator-( s64 offset ) const
+            {
+                return Iter( m_beginElems, m_idx - offset );
+            }
+            s64 operator-( const Iter& other ) const
+            {
+                return m_idx - other.m_idx;
+            }
+
+            bool operator==( const Iter& other ) const
+            {
+                return m_idx == other.m_idx;
+            }
+            bool operator!=( const Iter& other ) const
+            {
+                return m_idx != other.m_idx;
+            }
+            bool operator<( const Iter& other ) const
+            {
+                return m_idx < other.m_idx;
+            }
+            bool operator>( const Iter& other ) const
+            {
+                return m_idx > other.m_idx;
+            }
+            bool operator<=( const Iter& other ) const
+            {
+                return m_idx <= other.m_idx;
+            }
+            bool operator>=( const Iter& other ) const
+            {
+                return m_idx >= other.m_idx;
+            }
+
+        private:
+            Elems m_beginElems;
+            s64 m_idx = 0;
+        };
+
+        /// First element of each state
+        Elems beginElems;
+        u64 count = 0;
+
+        Iter begin() const
+        {
+            return Iter( beginElems, 0 );
+        }
+        Iter end() const
+        {
+            return Iter( beginElems, s64( count ) );
+        }
+
+        u64 size() const
+        {
+            return count;
+        }
+
+        Elems operator[]( u64 idx ) const
+        {
+            return elemsAt( beginElems, idx );
+        }
+
+        /// Contiguous array of 'size()' elements of one of the states
+        template< class ElementType >
+        ElementType* data() const
+        {
+            return std::get< ElementIndex< ElementType, ElementTypes... >::VALUE >( beginElems );
+        }
+
+        /// View on 'subCount' objects starting at index 'first' (clamped to this view)
+        StateView subView( u64 first, u64 subCount ) const
+        {
+            if ( first > count ) {
+                first = count;
+            }
+            if ( subCount > count - first ) {
+                subCount = count - first;
+            }
+            StateView sub;
+            sub.beginElems = elemsAt( beginElems, first );
+            sub.count      = subCount;
+            return sub;
+        }
+
+    private:
+        static Elems elemsAt( const Elems& beginElems, u64 idx )
+        {
+            return elemsAt( beginElems, idx, typename MakeIndexSeq< sizeof...( ElementTypes ) >::Type() );
+        }
+        template< u64... Indices >
+        static Elems elemsAt( const Elems& beginElems, u64 idx, IndexSeq< Indices... > )
+        {
+            return Elems( std::get< Indices >( beginElems ) + idx... );
+        }
+    };
+
+    /// Result of resolving a sequence of handles kept around for reuse by 'resolveCached()'
+    ///
+    /// Stays valid as long as the handles are the same and the layout of the target type did not
+    /// change (no destruction/relocation of objects in between).
+    template< class ElementType >
+    struct ResolveCache
+    {
+        std::vector< u64 > handles;
+        std::vector< ElementType* > elems;
+        u64 validCount    = 0;
+        u64 layoutVersion = 0;
+    };
+
+    /// Creates objects of one type concurrently with other 'Creator's (e.g. one per chunk of a
+    /// 'parallelFor()' loop)
+    ///
+    /// Slots are reserved in blocks with one atomic operation per block and filled without
+    /// synchronization. New objects have valid handles right away but do not show up in state
+    /// ranges/views or 'count()' before the next 'flushCreates()'. Slots still unused on
+    /// destruction are given back. Creation is limited to committed capacity (see
+    /// 'reserveObjects()') as memory can not be committed while other threads access the type.
+    struct Creator
+    {
+        Creator( StateDb& sdb, u64 typeId, u64 blockObjectCount = 64 );
+        virtual ~Creator();
+
+        /// Like 'StateDb::create()' (returns 'nullptr' if out of capacity)
+        template< class ElementType >
+        ElementType* create( u64& createdObjectHandle )
+        {
+            const StateData& data = m_sdb->stateData< ElementType >();
+            COMMON_ASSERT( data.typeId == m_typeId );
+
+            u64 idx = reserveIdx();
+            if ( !idx ) {
+                createdObjectHandle = 0;
+                return nullptr;
+            }
+            createdObjectHandle = m_sdb->activateReserved( m_sdb->m_types[ m_typeId ], idx );
+            return (ElementType*)( data.values + idx * sizeof( ElementType ) );
+        }
+
+    private:
+        StateDb* m_sdb         = nullptr;
+        u64 m_typeId           = 0;
+        u64 m_blockObjectCount = 0;
+        // Unused part of current block
+        u64 m_nextIdx = 0;
+        u64 m_endIdx  = 0;
+
+        u64 reserveIdx();
+        void releaseBlock();
+
+    private:
+        COMMON_DISABLE_COPY( Creator )
+    };
+
+    /// Records structural changes and writes of one thread (e.g. one per chunk of a
+    /// 'parallelFor()' loop) that are played back at the next sync point
+    ///
+    /// Creates go through one 'Creator' per type so their handles are valid right away (also as
+    /// targets of later commands) and the initial element is stored in place. Destroys and writes
+    /// are appended to a linear byte buffer owned by the command buffer (no synchronization while
+    /// recording). Commands are submitted to the database on destruction (or 'submit()') and played
+    /// back at the end of the outermost 'parallelFor()' (or by calling 'playbackCommands()').
+    struct CommandBuffer
+    {
+        CommandBuffer( StateDb& sdb );
+        virtual ~CommandBuffer();
+
+        /// Creates object with its 'ElementType' state initialized from 'elem' and all other
+        /// states set to default values (returns 0 if out of capacity)
+        template< class ElementType >
+        u64 create( const ElementType& elem )
+        {
+            const StateData& data = m_sdb->stateData< ElementType >();
+
+            u64 createdObjectHandle = 0;
+            ElementType* createdElem =
+                creator( data.typeId ).template create< ElementType >( createdObjectHandle );
+            if ( createdElem ) {
+                *createdElem = elem;
+            }
+            return createdObjectHandle;
+        }
+
+        /// Overwrites 'ElementType' state of object on playback (skipped if handle became invalid)
+        template< class ElementType >
+        void write( u64 objectHandle, const ElementType& elem )
+        {
+            // Validates state (no columns of 'SPLIT' states)
+            m_sdb->stateData< ElementType >();
+            record( Command::WRITE, objectHandle, ElementType::STATE, &elem, sizeof( ElementType ) );
+        }
+
+        /// Destroys object (deferred) on playback (skipped if handle became invalid)
+        void destroy( u64 objectHandle );
+
+        /// Hands recorded commands over to database and releases reserved slots of creators
+        void submit();
+
+        u64 commandCount() const;
+
+    private:
+        struct Command
+        {
+            enum Kind
+            {
+                WRITE   = 1,
+                DESTROY = 2
+            };
+            u64 kind;
+            u64 objectHandle;
+            u64 stateId;
+            // Payload follows header (padded to multiple of 8 B)
+            u64 sizeInB;
+        };
+
+        StateDb* m_sdb = nullptr;
+        std::vector< unsigned char > m_commands;
+        u64 m_commandCount = 0;
+        // Created on first use (indexed by type ID)
+        std::vector< std::shared_ptr< Creator > > m_creators;
+
+        Creator& creator( u64 typeId );
+        void record( u64 kind, u64 objectHandle, u64 stateId, const void* payload, u64 sizeInB );
+
+        friend struct StateDb;
+
+    private:
+        COMMON_DISABLE_COPY( CommandBuffer )
+    };
+
+    /// Immutable copy of selected states (handles resolve like at time of publishing)
+    struct Snapshot
+    {
+        u64 frame = 0;
+
+        template< class ElementType >
+        StateRange< const ElementType > stateAll() const
+        {
+            const StateCopy& copy = stateCopy< ElementType >();
+
+            // Element 0 is the null element ==> live elements start at index 1
+            StateRange< const ElementType > range;
+            range.beginElem = (const ElementType*)copy.values.data() + 1;
+            range.endElem   = range.beginElem + types[ copy.typeId ].objectCount;
+            return range;
+        }
+
+        /// Returns 'nullptr' if handle was invalid at time of publishing
+        template< class ElementType >
+        const ElementType* state( u64 objectHandle ) const
+        {
+            const StateCopy& copy = stateCopy< ElementType >();
+            if ( objectHandleTypeId( objectHandle ) != copy.typeId ) {
+                return nullptr;
+            }
+            const TypeCopy& type = types[ copy.typeId ];
+            u32 objectId         = objectHandleObjectId( objectHandle );
+            if ( objectId < 1 || objectId >= type.lifecycleByObjectId.size()
+                 || type.lifecycleByObjectId[ objectId ] != objectHandleLifecycle( objectHandle ) ) {
+                return nullptr;
+            }
+            return (const ElementType*)copy.values.data() + type.objectIdToIdx[ objectId ];
+        }
+
+    private:
+        friend struct StateDb;
+
+        struct TypeCopy
+        {
+            u64 objectCount = 0;
+            std::vector< u64 > objectIdToIdx;
+            std::vector< u64 > lifecycleByObjectId;
+        };
+
+        struct StateCopy
+        {
+            u64 typeId   = 0;
+            u64 elemSize = 0;
+            // Includes null element so that indices match the state database
+            std::vector< unsigned char > values;
+        };
+
+        // Indexed by type/state ID (empty for types/states not selected for snapshots)
+        std::vector< TypeCopy > types;
+        std::vector< StateCopy > states;
+
+        template< class ElementType >
+        const StateCopy& stateCopy() const
+        {
+            COMMON_ASSERT( ElementType::STATE < states.size() );
+            const StateCopy& copy = states[ ElementType::STATE ];
+            COMMON_ASSERT( copy.elemSize == sizeof( ElementType ) );
+            return copy;
+        }
+    };
+
+    /// Arena is placed in a named shared memory segment if 'sharedArenaName' is given so that other
+    /// processes can map state arrays read-only (see 'StateDbMirror')
+    StateDb(
+        u64 flags = 0, u64 arenaSizeInB = 16ull * 1024 * 1024 * 1024,
+        const std::string& sharedArenaName = "" );
     virtual ~StateDb();
 
     bool isTypeIdValid( u64 typeId );
     u64 typeIdByName( const std::string& name );
-    u64 registerType( const std::string& name, u64 maxObjectCount = 128ull );
+    u64 registerType(
+        const std::string& name, u64 maxObjectCount = 128ull, u64 flags = 0, u64 pageObjectCount = 256ull );
+    TypeStats typeStats( u64 typeId );
 
     bool isStateIdValid( u64 stateId );
     u64 stateIdByName( const std::string& name );
     std::string stateNameById( u64 stateId );
-    u64 registerState( u64 typeId, const std::string& name, u64 elemSize );
+    u64 registerState(
+        u64 typeId, const std::string& name, u64 elemSize, const void* defaultElem = nullptr, u64 flags = 0,
+        const std::vector< Field >& fields = std::vector< Field >() );
+
+    /// Registers state using a default constructed element as initial value of new objects
+    template< class ElementType >
+    u64 registerState(
+        u64 typeId, const std::string& name, u64 flags = 0,
+        const std::vector< Field >& fields = std::vector< Field >() )
+    {
+        // TODO(martinmo): Use 'std::is_trivially_copyable()' to make sure state struct
+        // TODO(martinmo): can be relocated with 'memcpy()' once all our compilers support it
+
+        // Zero memory before construction so that padding bytes are deterministic
+        std::vector< unsigned char > defaultElem( sizeof( ElementType ), 0 );
+        new ( &defaultElem[ 0 ] ) ElementType();
+        return registerState( typeId, name, sizeof( ElementType ), &defaultElem[ 0 ], flags, fields );
+    }
+
+    /// Introspection for generic tooling (type IDs range from 1 to 'typeCount()')
+    u64 typeCount();
+    std::string typeNameById( u64 typeId );
+    /// States as registered (columns of 'SPLIT' states are not listed separately)
+    std::vector< u64 > typeStateIds( u64 typeId );
+    u64 stateFlags( u64 stateId );
+    std::vector< Field > stateFields( u64 stateId );
+    /// Handle of object currently stored at index 'idx' (1 to 'count()') of its type
+    u64 objectHandleByIdx( u64 typeId, u64 idx );
+    /// Address of a field of an object regardless of state layout (or 'nullptr' if handle is
+    /// invalid), writes through it are not seen by change consumers
+    void* fieldValue( u64 stateId, u64 fieldIdx, u64 objectHandle );
 
     bool isHandleValid( u64 objectHandle );
     std::string handleTypeName( u64 objectHandle );
@@ -95,52 +651,109 @@ struct StateDb
     template< class ElementType >
     u64 handleFromState( ElementType* elem )
     {
-        COMMON_ASSERT( isStateIdValid( ElementType::STATE ) );
-
-        const State& state = m_states[ ElementType::STATE ];
-        const Type& type   = m_types[ state.typeId ];
+        const StateData& data = stateData< ElementType >();
 
-        u64 offsetInB = (unsigned char*)elem - &m_stateValues[ ElementType::STATE ][ 0 ];
-        if ( offsetInB % state.elemSize != 0 ) {
+        u64 offsetInB = (unsigned char*)elem - data.values;
+        if ( offsetInB % sizeof( ElementType ) != 0 ) {
             return 0;
         }
-        if ( offsetInB / state.elemSize > type.objectCount ) {
+        if ( offsetInB / sizeof( ElementType ) > data.objectCount ) {
             return 0;
         }
 
-        u64 objectId = type.idxToObjectId[ offsetInB / state.elemSize ];
+        const Type& type = m_types[ data.typeId ];
+        u64 objectId     = type.idxToObjectId[ offsetInB / sizeof( ElementType ) ];
         return composeObjectHandle(
-            u16( state.typeId ), u16( type.lifecycleByObjectId[ objectId ] ), u32( objectId ) );
+            u16( data.typeId ), u16( type.lifecycleByObjectId[ objectId ] ), u32( objectId ) );
     }
 
     void destroy( u64 objectHandle );
     int count( u64 typeId );
 
-    template< class ElementType >
-    ElementType* create( u64& createdObjectHandle )
+    /// Creates object with all of its states set to default values (returns 0 if out of memory)
+    u64 createObject( u64 typeId );
+
+    /// Commits memory for at least 'count' objects on top of the live ones (e.g. as headroom for
+    /// 'Creator's) and returns false if that would exceed the maximum object count
+    bool reserveObjects( u64 typeId, u64 count );
+
+    /// Makes objects of all 'Creator's visible in state ranges (all creators have to be done)
+    void flushCreates();
+
+    /// Flushes creates and applies all submitted 'CommandBuffer's: writes grouped by state in
+    /// index order (later writes to the same element win) followed by deferred destroys
+    void playbackCommands();
+
+    /// Reorders objects of a type by ascending 'keyFunc( u64 idx )' (stable) by permuting all of
+    /// its states in place and returns number of objects moved
+    ///
+    /// Handles stay valid (only ID to index maps change). Objects that are sorted already except
+    /// for a few (e.g. sorted last frame) are re-sorted by insertion in about linear time so that
+    /// sorting every frame is affordable. Otherwise a radix sort on the keys is used.
+    u64 sortType( u64 typeId, const std::function< u64( u64 idx ) >& keyFunc );
+
+    /// Like 'sortType()' with keys taken from one state ('keyFunc( const ElementType& elem )')
+    template< class ElementType, class Func >
+    u64 sortType( Func keyFunc )
     {
-        COMMON_ASSERT( isStateIdValid( ElementType::STATE ) );
+        const StateData& data = stateData< ElementType >();
 
-        // TODO(martinmo): Encode type ID into the state ID (==> state handle)
-        // TODO(martinmo): ==> Avoid lookup in 'm_states' (see 'stateAll()' for more profiteers)
+        const ElementType* elems = (const ElementType*)data.values + 1;
+        m_sortKeys.resize( data.objectCount );
+        for ( u64 i = 0; i < data.objectCount; ++i ) {
+            m_sortKeys[ i ] = keyFunc( elems[ i ] );
+        }
+        return sortObjects( m_types[ data.typeId ] );
+    }
 
-        u64 typeId = m_states[ ElementType::STATE ].typeId;
+    /// Invalidates handle immediately but keeps object (and therefore all state ranges) in place
+    /// until the next 'flushDestroys()' which removes all pending objects of a type in one pass
+    void destroyDeferred( u64 objectHandle );
+    /// Also applies relations (see 'registerRelation()') until no further objects are destroyed
+    void flushDestroys();
 
-        COMMON_ASSERT( isTypeIdValid( typeId ) );
+    /// Declares 'HANDLE' field 'fieldName' of state as reference to objects of type 'targetTypeId'
+    ///
+    /// After every 'flushDestroys()' relation fields hold either 0 or a valid handle of the target
+    /// type: if objects of the target type were destroyed since the last flush, the relation field
+    /// is checked in one pass over the referencing state and referencing objects of destroyed
+    /// objects are nullified or destroyed in batch (cascading further). Fields are expected to be
+    /// set to 0 or valid handles only (stale handles written later are caught with next destroy).
+    void registerRelation(
+        u64 stateId, const std::string& fieldName, u64 targetTypeId, RelationAction onDestroy );
+
+    template< class ElementType >
+    ElementType* create( u64& createdObjectHandle )
+    {
+        const StateData& data = stateData< ElementType >();
 
-        Type& type = m_types[ typeId ];
-        if ( type.objectCount >= type.maxObjectCount ) {
-            Logger::debug( "WARNING: Out of memory for type \"%s\"", type.name.c_str() );
-            createdObjectHandle = 0;
+        u64 idx = createObjects( m_types[ data.typeId ], 1, &createdObjectHandle );
+        if ( !idx ) {
             return nullptr;
         }
+        return (ElementType*)( data.values + idx * sizeof( ElementType ) );
+    }
 
-        u64 objectId   = type.idxToObjectId[ ++type.objectCount ];
-        u64& lifecycle = type.lifecycleByObjectId[ objectId ];
-        ++lifecycle;
+    /// Creates objects in one contiguous index range with all of their states set to default
+    /// values except for 'ElementType' which is initialized from 'prototype'
+    ///
+    /// Returns pointer to first of 'count' consecutive elements (or 'nullptr' if 'count' is zero or
+    /// out of memory in which case no object is created at all).
+    template< class ElementType >
+    ElementType* createBatch( u64 count, const ElementType& prototype, u64* createdObjectHandles = nullptr )
+    {
+        if ( count == 0 ) {
+            return nullptr;
+        }
+        const StateData& data = stateData< ElementType >();
 
-        createdObjectHandle = composeObjectHandle( u16( typeId ), u16( lifecycle ), u32( objectId ) );
-        return state< ElementType >( createdObjectHandle );
+        u64 idx = createObjects( m_types[ data.typeId ], count, createdObjectHandles );
+        if ( !idx ) {
+            return nullptr;
+        }
+        ElementType* elems = (ElementType*)( data.values + idx * sizeof( ElementType ) );
+        fillElems( elems, &prototype, count, sizeof( ElementType ) );
+        return elems;
     }
 
     template< class ElementType >
@@ -153,57 +766,399 @@ struct StateDb
     template< class ElementType >
     ElementType* state( u64 objectHandle )
     {
-        COMMON_ASSERT( isStateIdValid( ElementType::STATE ) );
-        COMMON_ASSERT( m_states[ ElementType::STATE ].elemSize == sizeof( ElementType ) );
-
-        u64 typeIdFromHandle = objectHandleTypeId( objectHandle );
+        const StateData& data = stateData< ElementType >();
 
-        COMMON_ASSERT( isHandleValid( objectHandle ) );
-        COMMON_ASSERT( typeIdFromHandle == m_states[ ElementType::STATE ].typeId );
+        COMMON_ASSERT( isHandleValid( data, objectHandle ) );
 
-        // Type lookup needed here for object ID to index translation
-        const Type& type = m_types[ typeIdFromHandle ];
-        return (ElementType*)&m_stateValues[ ElementType::STATE ]
-                                           [ type.objectIdToIdx[ objectHandle & 0xffffffff ]
-                                             * sizeof( ElementType ) ];
+        // Object ID to index translation through cached map (no type lookup needed)
+        u64 idx = data.objectIdToIdx[ objectHandleObjectId( objectHandle ) ];
+        return (ElementType*)( data.values + idx * sizeof( ElementType ) );
     }
 
     template< class ElementType >
     StateRange< ElementType > stateAll()
     {
+        const StateData& data = stateData< ElementType >();
+
+        // Element 0 is the null element ==> live elements start at index 1
         StateRange< ElementType > range;
+        range.beginElem = (ElementType*)data.values + 1;
+        range.endElem   = range.beginElem + data.objectCount;
+        return range;
+    }
 
-        COMMON_ASSERT( isStateIdValid( ElementType::STATE ) );
-        COMMON_ASSERT( m_states[ ElementType::STATE ].elemSize == sizeof( ElementType ) );
+    /// Registers consumer of changes to a 'TRACK_CHANGES' state and returns its ID
+    ///
+    /// All live elements are dirty for a new consumer. Creation and relocation of objects (due to
+    /// destruction of other objects) mark the affected elements dirty as well.
+    u64 registerChangeConsumer( u64 stateId );
 
-        // TODO(martinmo): Encode type ID into the state ID (==> state handle)
-        // TODO(martinmo): ==> Avoid lookup in 'm_states' (see 'create()' for more profiteers)
+    /// Incremented on every change of a 'TRACK_CHANGES' state (cheap "anything changed?" test)
+    u64 stateVersion( u64 stateId );
 
-        // TODO(martinmo): Store object count in memory block itself
-        // TODO(martinmo): ==> This way we can avoid type/implicit state lookup altogether
+    /// Ascending indices (1 to 'count()') of objects whose tag word (element of a 'TRACK_CHANGES'
+    /// state of 'u64' bit sets) has all bits of 'allMask', any bit of 'anyMask' (if not 0) and no
+    /// bit of 'noneMask' set
+    ///
+    /// Tag words are matched with SIMD (two per SSE2 register) and the resulting list is cached
+    /// until the tag state changes (or objects are relocated) so that loops only visit matching
+    /// objects without touching their other states. The list stays valid until the next call for
+    /// the same query.
+    const std::vector< u32 >& selectTagged( u64 tagStateId, u64 allMask, u64 anyMask, u64 noneMask = 0 );
 
-        const Type& type = m_types[ m_states[ ElementType::STATE ].typeId ];
+    /// Like 'state()' but marks element dirty for all change consumers
+    template< class ElementType >
+    ElementType* stateMut( u64 objectHandle )
+    {
+        ElementType* elem = state< ElementType >( objectHandle );
+        markDirty( elem );
+        return elem;
+    }
+
+    /// Marks element dirty for all change consumers (safe to call from 'parallelFor()' loops)
+    template< class ElementType >
+    void markDirty( const ElementType* elem )
+    {
+        const StateData& data = stateData< ElementType >();
+
+        u64 idx = u64( elem - (const ElementType*)data.values );
+        COMMON_ASSERT( idx >= 1 && idx <= data.objectCount );
+        markDirty( data, idx );
+    }
+
+    /// Calls 'func( ElementType* elem )' for all live elements marked dirty since the last call
+    /// for the same consumer, clears consumer's dirty bits and returns number of elements visited
+    template< class ElementType, class Func >
+    u64 forEachChanged( u64 consumerId, Func func )
+    {
+        const StateData& data = stateData< ElementType >();
+        COMMON_ASSERT( data.changes && consumerId < data.changes->dirtyWordsByConsumer.size() );
+
+        std::atomic< u64 >* dirtyWords = data.changes->dirtyWordsByConsumer[ consumerId ].get();
+        ElementType* elems             = (ElementType*)data.values;
+        u64 visitedCount               = 0;
+        // Stale bits past the object count are left alone (set again once indices are reused)
+        for ( u64 wordIdx = 0; wordIdx <= data.objectCount / 64; ++wordIdx ) {
+            if ( !dirtyWords[ wordIdx ].load( std::memory_order_relaxed ) ) {
+                continue;
+            }
+            u64 bits = dirtyWords[ wordIdx ].exchange( 0, std::memory_order_relaxed );
+            for ( ; bits; bits &= bits - 1 ) {
+                u64 idx = wordIdx * 64 + lowestBitIdx( bits );
+                if ( idx >= 1 && idx <= data.objectCount ) {
+                    func( elems + idx );
+                    ++visitedCount;
+                }
+            }
+        }
+        return visitedCount;
+    }
+
+    struct LifecycleEvent
+    {
+        enum Kind
+        {
+            CREATED   = 1,
+            DESTROYED = 2
+        };
+        u64 objectHandle;
+        u64 kind;
+    };
+
+    /// Registers cursor into the lifecycle journal of a type and returns its ID
+    ///
+    /// Journals are only kept for types with cursors. All objects live at registration are
+    /// reported as created to a new cursor. Events are dropped once all cursors of a type have
+    /// visited them (a cursor that is never visited keeps the journal growing).
+    u64 registerLifecycleCursor( u64 typeId );
+
+    /// Calls 'func( const LifecycleEvent& event )' for all creations and destructions of objects of
+    /// a type (in order) since the last call for the same cursor and returns number of events
+    ///
+    /// Objects created by 'Creator's are reported on flush. Objects destroyed through
+    /// 'destroyDeferred()' are reported right away (their handles are invalid already).
+    template< class Func >
+    u64 forEachLifecycleEvent( u64 typeId, u64 cursorId, Func func )
+    {
+        COMMON_ASSERT( isTypeIdValid( typeId ) );
+        Journal& journal = m_types[ typeId ].journal;
+        COMMON_ASSERT( cursorId < journal.cursorSeqs.size() );
 
-        // TODO(martinmo): Pointers to first and last element never change at runtime ==> store
+        u64 visitedCount = 0;
+        if ( !journal.initialHandlesByCursor[ cursorId ].empty() ) {
+            std::vector< u64 > initialHandles;
+            initialHandles.swap( journal.initialHandlesByCursor[ cursorId ] );
+            for ( u64 objectHandle : initialHandles ) {
+                LifecycleEvent event = { objectHandle, LifecycleEvent::CREATED };
+                func( event );
+                ++visitedCount;
+            }
+        }
+        // 'func' may create/destroy objects of the same type ==> copy events before calling it
+        u64 eventIdx = journal.cursorSeqs[ cursorId ] - journal.firstSeq;
+        for ( ; eventIdx < journal.events.size(); ++eventIdx ) {
+            LifecycleEvent event = journal.events[ eventIdx ];
+            func( event );
+            ++visitedCount;
+        }
+        journal.cursorSeqs[ cursorId ] = journal.firstSeq + eventIdx;
+        trimJournal( journal );
+        return visitedCount;
+    }
+
+    /// Resolves 'count' handles to element pointers in one go ('nullptr' for invalid handles)
+    ///
+    /// Handles are read with a stride of 'handleStrideInB' bytes which allows to resolve handle
+    /// fields of state elements in place (e.g. '&range.beginElem->meshHandle'). Returns number of
+    /// valid handles.
+    template< class ElementType >
+    u64 resolve( const u64* handles, u64 count, ElementType** elems, u64 handleStrideInB = sizeof( u64 ) )
+    {
+        const StateData& data = stateData< ElementType >();
+
+        const unsigned char* handleBytes = (const unsigned char*)handles;
+        u64 validCount                   = 0;
+        for ( u64 i = 0; i < count; ++i ) {
+            // Prefetch ID maps for handles a few iterations ahead to overlap cache misses
+            u64 aheadIdx = i + RESOLVE_PREFETCH_DISTANCE;
+            if ( aheadIdx < count ) {
+                u64 aheadHandle = *(const u64*)( handleBytes + aheadIdx * handleStrideInB );
+                u32 aheadId     = objectHandleObjectId( aheadHandle );
+                if ( aheadId <= data.objectCapacity ) {
+                    COMMON_PREFETCH( data.objectIdToIdx + aheadId );
+                    COMMON_PREFETCH( data.lifecycleByObjectId + aheadId );
+                }
+            }
+            u64 handle = *(const u64*)( handleBytes + i * handleStrideInB );
+            if ( !isHandleValid( data, handle ) ) {
+                elems[ i ] = nullptr;
+                continue;
+            }
+            elems[ i ] = (ElementType*)( data.values + data.objectIdToIdx[ objectHandleObjectId( handle ) ]
+                                                        * sizeof( ElementType ) );
+            // Caller is going to touch element next ==> start loading it
+            COMMON_PREFETCH( elems[ i ] );
+            ++validCount;
+        }
+        return validCount;
+    }
+
+    /// Like 'resolve()' but only resolves handles again if they differ from the ones cached or
+    /// if the layout of the target type has changed since (returns pointer to cached elements)
+    template< class ElementType >
+    ElementType* const* resolveCached(
+        ResolveCache< ElementType >& cache, const u64* handles, u64 count,
+        u64 handleStrideInB = sizeof( u64 ) )
+    {
+        const StateData& data = stateData< ElementType >();
+        u64 layoutVersion     = m_types[ data.typeId ].layoutVersion;
+
+        const unsigned char* handleBytes = (const unsigned char*)handles;
+        bool hit = cache.layoutVersion == layoutVersion && cache.handles.size() == count;
+        for ( u64 i = 0; hit && i < count; ++i ) {
+            hit = cache.handles[ i ] == *(const u64*)( handleBytes + i * handleStrideInB );
+        }
+        if ( !hit ) {
+            cache.handles.resize( count );
+            cache.elems.resize( count );
+            for ( u64 i = 0; i < count; ++i ) {
+                cache.handles[ i ] = *(const u64*)( handleBytes + i * handleStrideInB );
+            }
+            cache.validCount    = resolve( cache.handles.data(), count, cache.elems.data() );
+            cache.layoutVersion = layoutVersion;
+        }
+        return cache.elems.data();
+    }
+
+    /// Saves all objects (ID maps, lifecycles and values of all non-'TRANSIENT' states)
+    ///
+    /// Pending deferred destructions have to be flushed before saving.
+    bool saveImage( const std::string& filename );
+
+    /// Loads image saved by 'saveImage()' into empty database with identical types and states
+    ///
+    /// Handles stay valid across save/load. 'TRANSIENT' states are set to default values so that
+    /// modules can rebuild their runtime data. Fails without changes on schema mismatch.
+    bool loadImage( const std::string& filename );
+
+    /// Selects state to be included in published snapshots
+    void addSnapshotState( u64 stateId );
+
+    /// Copies selected states into the snapshot buffer not used by the reader and hands it over
+    /// (called by simulation once all updates of a frame are done, no-op if nothing is selected)
+    void publishSnapshot();
+
+    /// Returns most recently published snapshot (or 'nullptr' if none has been published yet)
+    ///
+    /// To be called by one reader thread only. The snapshot stays untouched by 'publishSnapshot()'
+    /// until the next call to 'acquireSnapshot()'.
+    const Snapshot* acquireSnapshot();
+
+    /// Captures all objects as base of forks created by 'fork()' (replaces previous base)
+    ///
+    /// Called by simulation at rest (deferred destructions flushed, no creators or submitted
+    /// commands pending). Costs one copy of the committed arena into a memory file that all forks
+    /// of the base map copy-on-write (returns false if platform does not support forks).
+    bool publishForkBase();
+
+    /// Copy-on-write copy of the most recently published fork base (e.g. for look-ahead simulation)
+    ///
+    /// Thread-safe and independent of this database: it may continue with the next frame while
+    /// forks run on worker threads. Types, states, objects, handles, change consumers and
+    /// lifecycle cursors are identical to the base and pages are shared until a fork writes them.
+    /// Forks cannot register types or states and are discarded by destroying them. Returns
+    /// 'nullptr' if no base has been published (or on failure).
+    std::unique_ptr< StateDb > fork();
+
+    /// Job system used by 'parallelFor()' (loops run on calling thread only if not set)
+    void setJobSystem( JobSystem* jobSystem );
+
+    /// Runs 'func( StateView< ElementTypes... > chunk )' for chunks of at least 'grain' objects
+    /// of a joined view in parallel and returns once all chunks have been processed
+    ///
+    /// Chunks are disjoint so 'func' may write to its own elements without synchronization.
+    /// Structural changes (object creation/destruction) are not allowed while the loop runs.
+    template< class... ElementTypes, class Func >
+    void parallelFor( u64 grain, Func func )
+    {
+        const StateView< ElementTypes... > all = view< ElementTypes... >();
+        parallelFor( all.size(), grain, [&all, &func]( u64 first, u64 count ) {
+            func( all.subView( first, count ) );
+        } );
+    }
+
+    /// Index-based variant of 'parallelFor()' for data living outside of the state database
+    void parallelFor( u64 count, u64 grain, const std::function< void( u64 first, u64 count ) >& func );
+
+    /// Joined view on states of one type, e.g. 'view< Mesh::Info, Mesh::PrivateInfo >()'
+    template< class... ElementTypes >
+    StateView< ElementTypes... > view()
+    {
+        const StateData* datas[] = { &stateData< ElementTypes >()... };
+        for ( const StateData* data : datas ) {
+            COMMON_ASSERT( data->typeId == datas[ 0 ]->typeId );
+        }
+
+        // Element 0 is the null element ==> live elements start at index 1
+        StateView< ElementTypes... > view;
+        view.beginElems = std::make_tuple( (ElementTypes*)stateData< ElementTypes >().values + 1 ... );
+        view.count      = datas[ 0 ]->objectCount;
+        return view;
+    }
+
+    /// Column of field 'fieldIdx' (index into fields given on registration) of a 'SPLIT' state
+    ///
+    /// Columns are aligned and padded like 'alignedRange()' and behave like state ranges (index i
+    /// of all columns and other states of the type refers to the same object).
+    template< class ElementType, class FieldType >
+    AlignedStateRange< FieldType > column( u64 fieldIdx )
+    {
+        const StateData& data = columnData< ElementType >( fieldIdx );
+        COMMON_ASSERT( data.elemSize == sizeof( FieldType ) );
+
+        AlignedStateRange< FieldType > range;
+        range.beginElem     = (FieldType*)data.values + 1;
+        range.endElem       = range.beginElem + data.objectCount;
+        range.paddedSizeInB = roundUpToStateAlignment( data.objectCount * sizeof( FieldType ) );
+        return range;
+    }
+
+    /// Field 'fieldIdx' of one object of a 'SPLIT' state
+    template< class ElementType, class FieldType >
+    FieldType* field( u64 objectHandle, u64 fieldIdx )
+    {
+        const StateData& data = columnData< ElementType >( fieldIdx );
+        COMMON_ASSERT( data.elemSize == sizeof( FieldType ) );
+
+        COMMON_ASSERT( isHandleValid( data, objectHandle ) );
+        return (FieldType*)data.values + data.objectIdToIdx[ objectHandleObjectId( objectHandle ) ];
+    }
+
+    template< class ElementType >
+    AlignedStateRange< ElementType > alignedRange()
+    {
+        const StateData& data = stateData< ElementType >();
 
-        std::vector< unsigned char >& memory = m_stateValues[ ElementType::STATE ];
-        unsigned char* memoryBegin           = &memory[ sizeof( ElementType ) ];
-        range.beginElem                      = (ElementType*)memoryBegin;
-        range.endElem = (ElementType*)( memoryBegin + sizeof( ElementType ) * type.objectCount );
+        AlignedStateRange< ElementType > range;
+        range.beginElem     = (ElementType*)data.values + 1;
+        range.endElem       = range.beginElem + data.objectCount;
+        range.paddedSizeInB = roundUpToStateAlignment( data.objectCount * sizeof( ElementType ) );
+        COMMON_ASSERT( u64( range.beginElem ) % STATE_ALIGNMENT_IN_B == 0 );
         return range;
     }
 
 private:
+    /// Object slots reserved by 'Creator's (past the live objects of a type)
+    struct Reservations
+    {
+        Reservations()
+            : count( 0 )
+        {
+        }
+
+        std::atomic< u64 > count;
+        std::mutex mutex;
+        // Slot ranges [first, end) given back by creators (guarded by 'mutex')
+        std::vector< std::pair< u64, u64 > > unusedRanges;
+    };
+
+    /// Append-only lifecycle events of one type (kept while type has cursors)
+    struct Journal
+    {
+        std::vector< LifecycleEvent > events;
+        // Sequence number of first event still around
+        u64 firstSeq = 0;
+        // Sequence number of next event to visit (by cursor ID)
+        std::vector< u64 > cursorSeqs;
+        std::vector< std::vector< u64 > > initialHandlesByCursor;
+    };
+
     struct Type
     {
         std::string name;
-        u64 id             = 0;
-        u64 maxObjectCount = 0;
-        u64 objectCount    = 0;
+        u64 id              = 0;
+        u64 flags           = 0;
+        u64 maxObjectCount  = 0;
+        u64 objectCapacity  = 0;
+        u64 pageObjectCount = 0;
+        u64 objectCount     = 0;
+        u64 peakObjectCount = 0;
+        // Hash of name, maximum object count, flags and page object count
+        u64 schemaHash = 0;
+        // Incremented whenever objects are relocated or handles are invalidated
+        u64 layoutVersion = 1;
         std::vector< u64 > stateIds;
         std::vector< u64 > objectIdToIdx;
         std::vector< u64 > idxToObjectId;
         std::vector< u64 > lifecycleByObjectId;
+        std::vector< u64 > pendingDestroyObjectIds;
+        std::shared_ptr< Reservations > reservations;
+        Journal journal;
+        // Objects were destroyed since relations referencing type were last applied
+        bool relationsDirty = false;
+    };
+
+    /// Cached result of 'selectTagged()' (versions of tag state and type at time of selection)
+    struct TagSelection
+    {
+        u64 stateVersion  = 0;
+        u64 layoutVersion = 0;
+        u64 objectCount   = 0;
+        bool valid        = false;
+        std::vector< u32 > idxs;
+    };
+
+    /// Per-consumer dirty bitsets (one bit per element index) of a 'TRACK_CHANGES' state
+    struct ChangeTracking
+    {
+        ChangeTracking()
+            : version( 0 )
+        {
+        }
+
+        std::atomic< u64 > version;
+        u64 wordCount = 0;
+        std::vector< std::unique_ptr< std::atomic< u64 >[] > > dirtyWordsByConsumer;
     };
 
     struct State
@@ -212,7 +1167,43 @@ private:
         std::string name;
         u64 id       = 0;
         u64 elemSize = 0;
-        // TODO(martinmo): Add version info here for protocol/struct changes
+        u64 flags    = 0;
+        // Hash of name, element size, flags, fields and default element (to detect layout changes)
+        u64 schemaHash = 0;
+
+        std::vector< Field > fields;
+        // 'SPLIT' states have no memory of their own but one column state per field
+        std::vector< u64 > columnStateIds;
+        u64 splitStateId = 0;  // 'SPLIT' state a column state belongs to
+
+        // Arena region for (max object count + 1) elements (element 0 is null element) with
+        // values starting at an offset so that element 1 is aligned
+        unsigned char* memory = nullptr;
+        u64 valuesOffsetInB   = 0;
+        u64 reservedInB       = 0;
+        u64 committedInB      = 0;
+
+        // Initial value of elements (empty if all-zero ==> committed memory is already default)
+        std::vector< unsigned char > defaultElem;
+
+        std::shared_ptr< ChangeTracking > changes;
+    };
+
+    /// Hot per-state data needed for handle resolution and iteration
+    ///
+    /// Indexed by state ID this duplicates everything 'state()', 'stateAll()' and 'create()' need
+    /// so that they do not have to go through 'm_states' and 'm_types' (which keep cold metadata).
+    /// The object count is updated for all states of a type on object creation/destruction.
+    struct StateData
+    {
+        unsigned char* values          = nullptr;
+        const u64* objectIdToIdx       = nullptr;
+        const u64* lifecycleByObjectId = nullptr;
+        u64 objectCount                = 0;
+        u64 objectCapacity             = 0;
+        u64 elemSize                   = 0;
+        u64 typeId                     = 0;
+        ChangeTracking* changes        = nullptr;
     };
 
     std::map< std::string, u64 > m_typeIdsByName;
@@ -221,7 +1212,229 @@ private:
     std::map< std::string, u64 > m_stateIdsByName;
     std::vector< State > m_states;
 
-    std::vector< std::vector< unsigned char > > m_stateValues;
+    std::vector< StateData > m_stateData;
+
+    struct Relation
+    {
+        // Column state for fields of 'SPLIT' states
+        u64 stateId      = 0;
+        u64 offsetInB    = 0;
+        u64 targetTypeId = 0;
+        u64 onDestroy    = NULLIFY;
+    };
+
+    std::vector< Relation > m_relations;
+    std::vector< u64 > m_relationTypeIds;
+
+    /// Copy of metadata and arena (in memory file) taken by 'publishForkBase()' (immutable)
+    struct ForkBase
+    {
+        ~ForkBase();
+
+        u64 flags          = 0;
+        u64 memoryPageSize = 0;
+        u64 arenaFile      = 0;
+        u64 arenaSizeInB   = 0;
+        // Arena the base was copied from (state memory is relocated relative to it)
+        const unsigned char* arena = nullptr;
+        std::map< std::string, u64 > typeIdsByName;
+        std::vector< Type > types;
+        std::map< std::string, u64 > stateIdsByName;
+        std::vector< State > states;
+        std::vector< Relation > relations;
+    };
+
+    /// Creates fork of 'base' (see 'fork()')
+    explicit StateDb( const ForkBase& base );
+
+    static std::shared_ptr< ChangeTracking > copyChangeTracking( const ChangeTracking& changes );
+
+    std::mutex m_forkBaseMutex;
+    std::shared_ptr< const ForkBase > m_forkBase;
+    // Objects of forks are discarded along with the fork
+    bool m_fork = false;
+
+    static const u64 IMAGE_FORMAT_VERSION = 1;
+
+    /// Image layout: header, type records (each followed by its three ID maps with capacity + 1
+    /// entries) and state records (each followed by its values padded to 8 B)
+    struct ImageHeader
+    {
+        char magic[ 8 ];
+        u64 formatVersion;
+        u64 schemaHash;
+        u64 typeCount;
+        u64 stateCount;
+    };
+    struct ImageType
+    {
+        u64 schemaHash;
+        u64 objectCount;
+        u64 peakObjectCount;
+        u64 objectCapacity;
+    };
+    struct ImageState
+    {
+        u64 schemaHash;
+        u64 valuesSizeInB;
+    };
+
+    static const u64 RESOLVE_PREFETCH_DISTANCE = 8;
+
+    /// Marks lifecycle of objects pending destruction (never matches the 16 bit handle lifecycle)
+    static const u64 LIFECYCLE_DESTROY_PENDING = 1ull << 63;
+
+    std::vector< u64 > m_typeIdsWithPendingDestroys;
+
+    // Slots reserved by 'Creator's over all types (structural changes have to wait for flush)
+    std::atomic< u64 > m_reservedObjectCount;
+    std::atomic< u64 > m_creatorCount;
+
+    // Byte buffers handed over by 'CommandBuffer::submit()' (guarded by mutex)
+    std::mutex m_submittedCommandsMutex;
+    std::vector< std::vector< unsigned char > > m_submittedCommands;
+    // Submitted buffers taken over by 'playbackCommands()' (swapped ==> both keep their capacity)
+    std::vector< std::vector< unsigned char > > m_playbackCommands;
+    std::vector< std::pair< u64, const CommandBuffer::Command* > > m_playbackWrites;
+
+    // Keyed by tag state ID and all/any/none masks
+    std::map< std::tuple< u64, u64, u64, u64 >, TagSelection > m_tagSelections;
+
+    u64 m_flags          = 0;
+    u64 m_memoryPageSize = 0;
+
+    unsigned char* m_arena = nullptr;
+    u64 m_arenaSizeInB     = 0;
+    u64 m_arenaUsedInB     = 0;
+    // Empty for private arena
+    std::string m_sharedArenaName;
+
+    /// Flags snapshot handed over by 'publishSnapshot()' but not yet taken by 'acquireSnapshot()'
+    static const u64 SNAPSHOT_FRESH = 0x4;
+
+    std::vector< u64 > m_snapshotStateIds;
+    std::vector< u64 > m_snapshotTypeIds;
+    u64 m_snapshotFrame = 0;
+    // Triple buffer: writer and reader own one snapshot each, third one is exchanged atomically
+    Snapshot m_snapshots[ 3 ];
+    u64 m_snapshotWriteIdx = 0;
+    u64 m_snapshotReadIdx  = 1;
+    std::atomic< u64 > m_snapshotSharedIdx;
+
+    template< class ElementType >
+    const StateData& stateData()
+    {
+        COMMON_ASSERT( isStateIdValid( ElementType::STATE ) );
+        const StateData& data = m_stateData[ ElementType::STATE ];
+        COMMON_ASSERT( data.elemSize == sizeof( ElementType ) );
+        // Elements of 'SPLIT' states only exist as columns
+        COMMON_ASSERT( data.values );
+        return data;
+    }
+
+    template< class ElementType >
+    const StateData& columnData( u64 fieldIdx )
+    {
+        COMMON_ASSERT( isStateIdValid( ElementType::STATE ) );
+        const State& state = m_states[ ElementType::STATE ];
+        COMMON_ASSERT( state.elemSize == sizeof( ElementType ) );
+        COMMON_ASSERT( fieldIdx < state.columnStateIds.size() );
+        return m_stateData[ state.columnStateIds[ fieldIdx ] ];
+    }
+
+    /// Values of state are part of images/recordings (not 'TRANSIENT' and not stored in columns)
+    static bool isStored( const State& state )
+    {
+        return !( state.flags & ( StateFlag::TRANSIENT | StateFlag::SPLIT ) );
+    }
+
+    bool isHandleValid( const StateData& data, u64 objectHandle )
+    {
+        u32 objectId = objectHandleObjectId( objectHandle );
+        return objectHandleTypeId( objectHandle ) == data.typeId && objectId >= 1
+            && objectId <= data.objectCapacity
+            && data.lifecycleByObjectId[ objectId ] == objectHandleLifecycle( objectHandle );
+    }
+
+    void markDirty( const StateData& data, u64 idx )
+    {
+        if ( !data.changes ) {
+            return;
+        }
+        for ( auto& dirtyWords : data.changes->dirtyWordsByConsumer ) {
+            dirtyWords[ idx / 64 ].fetch_or( 1ull << ( idx % 64 ), std::memory_order_relaxed );
+        }
+        data.changes->version.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    static u64 lowestBitIdx( u64 bits )
+    {
+#ifdef _MSC_VER
+        unsigned long bitIdx = 0;
+        _BitScanForward64( &bitIdx, bits );
+        return bitIdx;
+#else
+        return u64( __builtin_ctzll( bits ) );
+#endif
+    }
+
+    JobSystem* m_jobSystem = nullptr;
+    // Nested loops are started from worker threads ==> shared by all threads
+    std::atomic< u64 > m_parallelForDepth;
+
+    struct SortItem
+    {
+        u64 key;
+        u64 idx;
+    };
+
+    /// Maximum number of moves of insertion sort (relative to object count) before radix sorting
+    static const u64 SORT_INSERTION_MAX_MOVES_PER_OBJECT = 8;
+
+    // Sort buffers kept around so that sorting every frame does not allocate
+    std::vector< u64 > m_sortKeys;
+    std::vector< SortItem > m_sortItems;
+    std::vector< SortItem > m_sortItemsTmp;
+    std::vector< u64 > m_sortCycles;
+    std::vector< unsigned char > m_sortElem;
+
+    u64 sortObjects( Type& type );
+    static bool insertionSort( SortItem* items, u64 count, u64 maxMoveCount );
+    static void radixSort( std::vector< SortItem >& items, std::vector< SortItem >& itemsTmp );
+
+    void assertNoParallelFor();
+
+    u64 activateReserved( Type& type, u64 idx );
+    void flushCreates( Type& type );
+
+    void journalCreates( Type& type, u64 firstIdx, u64 count );
+    void journalDestroy( Type& type, u64 objectHandle );
+    void trimJournal( Journal& journal );
+
+    u64 registerSplitState( Type& type, State& newState, const std::string& name, const void* defaultElem );
+    u64 createObjects( Type& type, u64 count, u64* createdObjectHandles );
+    void resetElems( u64 stateId, u64 firstIdx, u64 count );
+    void markObjectsDirty( const Type& type, u64 firstIdx, u64 count );
+    void updateObjectCount( Type& type );
+    void flushDestroys( Type& type );
+    void applyRelations();
+    u64 stateSizeInB( const State& state, u64 objectCapacity );
+    bool commitStateMemory( State& state, u64 objectCapacity );
+    bool growType( Type& type );
+
+    static void fillElems( void* elems, const void* elem, u64 count, u64 elemSize );
+
+    u64 schemaHash();
+    bool validateImage(
+        const unsigned char* image, u64 imageSizeInB, std::vector< const ImageType* >& imageTypes,
+        std::vector< const ImageState* >& imageStates );
+    static u64 hashFields( const std::vector< Field >& fields, u64 hash );
+    static u64 hashBytes( const void* bytes, u64 sizeInB, u64 hash = 14695981039346656037ull );
+
+    static u64 roundUpToStateAlignment( u64 sizeInB )
+    {
+        return ( sizeInB + STATE_ALIGNMENT_IN_B - 1 ) / STATE_ALIGNMENT_IN_B * STATE_ALIGNMENT_IN_B;
+    }
 
     static u64 composeObjectHandle( u16 typeId, u16 lifecycle, u32 objectId );
     static u16 objectHandleTypeId( u64 objectHandle );
@@ -229,7 +1442,18 @@ private:
     static u32 objectHandleObjectId( u64 objectHandle );
 
 private:
+    friend struct StateDbRecorder;
+    friend struct StateDbPlayer;
+    friend struct StateDbMirror;
+
     COMMON_DISABLE_COPY( StateDb )
 };
 
+/// Field descriptor for member 'Member' of state element 'ElementType' (e.g.
+/// 'STATEDB_FIELD( Mesh::Info, translation, F32, 3 )')
+#define STATEDB_FIELD( ElementType, Member, Type, Count )                                                    \
+    StateDb::Field(                                                                                          \
+        #Member, StateDb::Field::Type, Count, offsetof( ElementType, Member ),                               \
+        sizeof( ( (ElementType*)nullptr )->Member ) )
+
 #endif
@@ -0,0 +1,164 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#include "StateDbMirror.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Logger.hpp"
+#include "Platform.hpp"
+#include "Profiler.hpp"
+#include "StateDb.hpp"
+
+const u64 StateDbMirrorLayout::MAGIC;
+const u64 StateDbMirrorLayout::FORMAT_VERSION;
+const u64 StateDbMirrorLayout::NAME_SIZE;
+const u64 StateDbMirrorLayout::MAX_TYPE_COUNT;
+const u64 StateDbMirrorLayout::MAX_STATE_COUNT;
+const u64 StateDbMirrorLayout::MAX_FIELD_COUNT;
+const u64 StateDbMirrorLayout::MAX_SECTION_COUNT;
+
+// -------------------------------------------------------------------------------------------------
+static void copyName( char* dst, const std::string& src )
+{
+    // Truncated names are still terminated
+    u64 length = std::min( u64( src.size() ), StateDbMirrorLayout::NAME_SIZE - 1 );
+    memcpy( dst, src.c_str(), length );
+    dst[ length ] = 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDbMirror::StateDbMirror( StateDb& sdb )
+    : m_sdb( sdb )
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDbMirror::~StateDbMirror()
+{
+    if ( m_segment ) {
+        Platform::destroySharedMemory( m_name, m_segment, sizeof( StateDbMirrorLayout::Segment ) );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDbMirror::open( const std::string& name )
+{
+    COMMON_ASSERT( !m_segment );
+    u64 segmentSizeInB = sizeof( StateDbMirrorLayout::Segment );
+    void* segment      = Platform::createSharedMemory( name, segmentSizeInB );
+    if ( !segment || !Platform::commitMemory( segment, segmentSizeInB ) ) {
+        Logger::debug( "ERROR: Failed to create shared memory segment \"%s\"", name.c_str() );
+        if ( segment ) {
+            Platform::destroySharedMemory( name, segment, segmentSizeInB );
+        }
+        return false;
+    }
+    m_name    = name;
+    m_segment = (StateDbMirrorLayout::Segment*)segment;
+
+    // Segment is zero-initialized ==> generation starts at 0 (at rest, no metadata yet)
+    StateDbMirrorLayout::Header& header = m_segment->header;
+    header.magic                        = StateDbMirrorLayout::MAGIC;
+    header.formatVersion                = StateDbMirrorLayout::FORMAT_VERSION;
+    if ( m_sdb.m_sharedArenaName.empty() ) {
+        Logger::debug( "WARNING: State database has no shared arena (only counts are mirrored)" );
+    }
+    copyName( header.arenaName, m_sdb.m_sharedArenaName );
+    header.arenaSizeInB = m_sdb.m_sharedArenaName.empty() ? 0 : m_sdb.m_arenaSizeInB;
+    publish();
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDbMirror::beginFrame()
+{
+    if ( !m_segment ) {
+        return;
+    }
+    StateDbMirrorLayout::Header& header = m_segment->header;
+    COMMON_ASSERT( header.generation.load( std::memory_order_relaxed ) % 2 == 0 );
+    header.generation.fetch_add( 1, std::memory_order_relaxed );
+    // Readers must not see any of the following writes before the odd generation
+    std::atomic_thread_fence( std::memory_order_release );
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDbMirror::publish()
+{
+    if ( !m_segment ) {
+        return;
+    }
+    StateDbMirrorLayout::Header& header = m_segment->header;
+    bool atRest                         = header.generation.load( std::memory_order_relaxed ) % 2 == 0;
+    if ( atRest ) {
+        beginFrame();
+    }
+
+    // Schema does not change after registration but is cheap enough to write every frame
+    u64 typeCount = std::min( u64( m_sdb.m_types.size() - 1 ), StateDbMirrorLayout::MAX_TYPE_COUNT );
+    for ( u64 typeId = 1; typeId <= typeCount; ++typeId ) {
+        const StateDb::Type& type            = m_sdb.m_types[ typeId ];
+        StateDbMirrorLayout::Type& typeEntry = m_segment->types[ typeId - 1 ];
+        copyName( typeEntry.name, type.name );
+        typeEntry.objectCount    = type.objectCount;
+        typeEntry.objectCapacity = type.objectCapacity;
+    }
+
+    u64 stateCount = std::min( u64( m_sdb.m_states.size() - 1 ), StateDbMirrorLayout::MAX_STATE_COUNT );
+    u64 fieldCount = 0;
+    for ( u64 stateId = 1; stateId <= stateCount; ++stateId ) {
+        const StateDb::State& state            = m_sdb.m_states[ stateId ];
+        StateDbMirrorLayout::State& stateEntry = m_segment->states[ stateId - 1 ];
+        copyName( stateEntry.name, state.name );
+        stateEntry.typeId          = state.typeId;
+        stateEntry.flags           = state.flags;
+        stateEntry.elemSize        = state.elemSize;
+        stateEntry.valuesOffsetInB = 0;
+        if ( state.memory && !m_sdb.m_sharedArenaName.empty() ) {
+            stateEntry.valuesOffsetInB = u64( state.memory + state.valuesOffsetInB - m_sdb.m_arena );
+        }
+
+        stateEntry.firstFieldIdx = fieldCount;
+        stateEntry.fieldCount    = 0;
+        for ( const StateDb::Field& field : state.fields ) {
+            if ( fieldCount == StateDbMirrorLayout::MAX_FIELD_COUNT ) {
+                break;
+            }
+            StateDbMirrorLayout::Field& fieldEntry = m_segment->fields[ fieldCount++ ];
+            copyName( fieldEntry.name, field.name );
+            fieldEntry.type      = u64( field.type );
+            fieldEntry.count     = field.count;
+            fieldEntry.offsetInB = field.offsetInB;
+            ++stateEntry.fieldCount;
+        }
+    }
+
+    u64 sectionCount                   = 0;
+    Profiler* profiling                = Profiler::instance();
+    const Profiler::Thread* mainThread = profiling->mainThreadPrevFrame();
+    if ( mainThread ) {
+        for ( const Profiler::SectionSample& sample : mainThread->samples ) {
+            if ( sectionCount == StateDbMirrorLayout::MAX_SECTION_COUNT ) {
+                break;
+            }
+            StateDbMirrorLayout::Section& sectionEntry = m_segment->sections[ sectionCount++ ];
+            copyName( sectionEntry.name, profiling->section( sample.sectionId ).name );
+            sectionEntry.callDepth = u64( sample.callDepth );
+            sectionEntry.enterMs   = profiling->ticksToMs( sample.ticksEnter );
+            sectionEntry.exitMs    = profiling->ticksToMs( sample.ticksExit() );
+        }
+    }
+
+    header.frame        = m_frame++;
+    header.typeCount    = typeCount;
+    header.stateCount   = stateCount;
+    header.fieldCount   = fieldCount;
+    header.sectionCount = sectionCount;
+
+    // Everything written above (and all state writes of the frame) become visible with even generation
+    header.generation.fetch_add( 1, std::memory_order_release );
+}
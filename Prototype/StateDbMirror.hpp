@@ -0,0 +1,127 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#ifndef STATEDBMIRROR_HPP
+#define STATEDBMIRROR_HPP
+
+#include "Common.hpp"
+
+#include <atomic>
+#include <string>
+
+struct StateDb;
+
+// -------------------------------------------------------------------------------------------------
+/// @brief Layout of shared memory segment written by 'StateDbMirror' (plain data only)
+///
+/// State values are not copied: records refer to state arrays by offset into the shared arena of
+/// the state database (see 'StateDb::StateDb()'). Readers map both segments read-only.
+struct StateDbMirrorLayout
+{
+    static const u64 MAGIC             = 0x524f5252494d4253ull;  // "SBMIRROR"
+    static const u64 FORMAT_VERSION    = 1;
+    static const u64 NAME_SIZE         = 56;
+    static const u64 MAX_TYPE_COUNT    = 256;
+    static const u64 MAX_STATE_COUNT   = 1024;
+    static const u64 MAX_FIELD_COUNT   = 4096;
+    static const u64 MAX_SECTION_COUNT = 256;
+
+    struct Header
+    {
+        u64 magic;
+        u64 formatVersion;
+        /// Odd while state database is modified, even while it is at rest (between end of
+        /// simulation and start of next frame), read like a sequence lock:
+        ///   g = generation (retry later if odd) ... read ... consistent if generation is still g
+        std::atomic< u64 > generation;
+        u64 frame;
+        // Empty if state database does not use a shared arena (counts/profiler data only)
+        char arenaName[ NAME_SIZE ];
+        u64 arenaSizeInB;
+        u64 typeCount;
+        u64 stateCount;
+        u64 fieldCount;
+        u64 sectionCount;
+    };
+
+    /// Type IDs are indices + 1
+    struct Type
+    {
+        char name[ NAME_SIZE ];
+        u64 objectCount;
+        u64 objectCapacity;
+    };
+
+    /// State IDs are indices + 1 (live elements start at index 1 of values)
+    struct State
+    {
+        char name[ NAME_SIZE ];
+        u64 typeId;
+        u64 flags;
+        u64 elemSize;
+        // Offset of element 0 into arena (0 if state has no values, e.g. 'StateDb::SPLIT')
+        u64 valuesOffsetInB;
+        u64 firstFieldIdx;
+        u64 fieldCount;
+    };
+
+    struct Field
+    {
+        char name[ NAME_SIZE ];
+        // 'StateDb::Field::Type'
+        u64 type;
+        u64 count;
+        u64 offsetInB;
+    };
+
+    /// Profiler sections of main thread of previous frame (in order of entry)
+    struct Section
+    {
+        char name[ NAME_SIZE ];
+        u64 callDepth;
+        double enterMs;
+        double exitMs;
+    };
+
+    struct Segment
+    {
+        Header header;
+        Type types[ MAX_TYPE_COUNT ];
+        State states[ MAX_STATE_COUNT ];
+        Field fields[ MAX_FIELD_COUNT ];
+        Section sections[ MAX_SECTION_COUNT ];
+    };
+};
+
+// -------------------------------------------------------------------------------------------------
+/// @brief Publishes metadata of a state database and profiler samples into a shared memory segment
+///
+/// Out-of-process inspectors (see 'Inspector' tool) read object counts, state arrays (zero copy
+/// through the shared arena) and profiler data without any work on the main loop besides updating
+/// a few hundred bytes of metadata per frame.
+struct StateDbMirror
+{
+    StateDbMirror( StateDb& sdb );
+    virtual ~StateDbMirror();
+
+    bool open( const std::string& name );
+
+    /// Marks state database as being modified (call at start of frame)
+    void beginFrame();
+    /// Updates metadata and marks state database as being at rest (call after
+    /// 'StateDb::flushDestroys()')
+    void publish();
+
+private:
+    StateDb& m_sdb;
+    std::string m_name;
+    StateDbMirrorLayout::Segment* m_segment = nullptr;
+    u64 m_frame                             = 0;
+
+private:
+    COMMON_DISABLE_COPY( StateDbMirror )
+};
+
+#endif
@@ -0,0 +1,560 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#include "StateDbRecording.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Assets.hpp"
+#include "Logger.hpp"
+#include "StateDb.hpp"
+
+static const char RECORDING_MAGIC[ 8 ] = { 'S', 'D', 'B', 'D', 'E', 'L', 'T', 'A' };
+static const u64 RECORDING_FORMAT_VERSION = 2;
+
+// Granularity of change detection
+static const u64 RECORDING_BLOCK_SIZE_IN_B = 64;
+
+// -------------------------------------------------------------------------------------------------
+static void writeVarint( std::vector< unsigned char >& out, u64 value )
+{
+    while ( value >= 0x80 ) {
+        out.push_back( (unsigned char)( value | 0x80 ) );
+        value >>= 7;
+    }
+    out.push_back( (unsigned char)value );
+}
+
+// -------------------------------------------------------------------------------------------------
+static bool readVarint( const unsigned char*& cursor, const unsigned char* end, u64& value )
+{
+    value = 0;
+    for ( u64 shift = 0; cursor < end && shift < 64; shift += 7 ) {
+        unsigned char byte = *cursor++;
+        value |= u64( byte & 0x7f ) << shift;
+        if ( !( byte & 0x80 ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Writes runs of blocks that differ between 'bytes' and 'shadow' and updates 'shadow'
+static u64 writeRuns(
+    std::vector< unsigned char >& out, const unsigned char* bytes, unsigned char* shadow, u64 sizeInB )
+{
+    std::vector< std::pair< u64, u64 > > runs;
+    for ( u64 offset = 0; offset < sizeInB; offset += RECORDING_BLOCK_SIZE_IN_B ) {
+        u64 blockSizeInB = std::min( RECORDING_BLOCK_SIZE_IN_B, sizeInB - offset );
+        if ( memcmp( bytes + offset, shadow + offset, blockSizeInB ) == 0 ) {
+            continue;
+        }
+        if ( !runs.empty() && runs.back().first + runs.back().second == offset ) {
+            runs.back().second += blockSizeInB;
+        }
+        else {
+            runs.push_back( std::make_pair( offset, blockSizeInB ) );
+        }
+    }
+
+    writeVarint( out, runs.size() );
+    for ( auto& run : runs ) {
+        writeVarint( out, run.first );
+        writeVarint( out, run.second );
+        // Tokens of (zero count, literal count, literals) of XOR with previous contents
+        u64 idx = run.first;
+        u64 end = run.first + run.second;
+        while ( idx < end ) {
+            u64 zeroCount = 0;
+            while ( idx + zeroCount < end && bytes[ idx + zeroCount ] == shadow[ idx + zeroCount ] ) {
+                ++zeroCount;
+            }
+            idx += zeroCount;
+            // Short zero runs are cheaper as part of literals than as separate token
+            u64 literalCount = 0;
+            u64 zeroRun      = 0;
+            while ( idx + literalCount + zeroRun < end && zeroRun < 4 ) {
+                u64 byteIdx = idx + literalCount + zeroRun;
+                if ( bytes[ byteIdx ] == shadow[ byteIdx ] ) {
+                    ++zeroRun;
+                }
+                else {
+                    literalCount += zeroRun + 1;
+                    zeroRun = 0;
+                }
+            }
+            writeVarint( out, zeroCount );
+            writeVarint( out, literalCount );
+            for ( u64 byteIdx = idx; byteIdx < idx + literalCount; ++byteIdx ) {
+                out.push_back( bytes[ byteIdx ] ^ shadow[ byteIdx ] );
+            }
+            idx += literalCount;
+        }
+        memcpy( shadow + run.first, bytes + run.first, run.second );
+    }
+    return runs.size();
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Applies runs written by 'writeRuns()' to 'bytes' (appends ranges applied to 'appliedRuns')
+static bool applyRuns(
+    const unsigned char*& cursor, const unsigned char* end, unsigned char* bytes, u64 sizeInB,
+    std::vector< std::pair< u64, u64 > >* appliedRuns = nullptr )
+{
+    u64 runCount = 0;
+    if ( !readVarint( cursor, end, runCount ) ) {
+        return false;
+    }
+    for ( u64 runIdx = 0; runIdx < runCount; ++runIdx ) {
+        u64 offset  = 0;
+        u64 runSize = 0;
+        if ( !readVarint( cursor, end, offset ) || !readVarint( cursor, end, runSize )
+             || offset + runSize > sizeInB ) {
+            return false;
+        }
+        u64 idx = offset;
+        while ( idx < offset + runSize ) {
+            u64 zeroCount    = 0;
+            u64 literalCount = 0;
+            if ( !readVarint( cursor, end, zeroCount ) || !readVarint( cursor, end, literalCount )
+                 || zeroCount + literalCount == 0 || idx + zeroCount + literalCount > offset + runSize
+                 || literalCount > u64( end - cursor ) ) {
+                return false;
+            }
+            idx += zeroCount;
+            for ( u64 literalIdx = 0; literalIdx < literalCount; ++literalIdx ) {
+                bytes[ idx++ ] ^= *cursor++;
+            }
+        }
+        if ( appliedRuns ) {
+            appliedRuns->push_back( std::make_pair( offset, runSize ) );
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Extends ID maps of shadow the same way 'StateDb::growType()' extends those of state database
+static void extendShadowMaps(
+    std::vector< u64 >& objectIdToIdx, std::vector< u64 >& idxToObjectId,
+    std::vector< u64 >& lifecycleByObjectId, u64 mapCount )
+{
+    for ( u64 id = objectIdToIdx.size(); id < mapCount; ++id ) {
+        objectIdToIdx.push_back( id );
+        idxToObjectId.push_back( id );
+        lifecycleByObjectId.push_back( 0 );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Resizes shadow of state (unused elements of state database hold default values ==> so do new
+/// elements of shadow)
+static void resizeShadow(
+    std::vector< unsigned char >& shadow, u64 sizeInB, const std::vector< unsigned char >& defaultElem )
+{
+    while ( shadow.size() < sizeInB ) {
+        if ( defaultElem.empty() ) {
+            shadow.resize( sizeInB, 0 );
+        }
+        else {
+            shadow.insert( shadow.end(), defaultElem.begin(), defaultElem.end() );
+        }
+    }
+    shadow.resize( sizeInB );
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDbRecorder::StateDbRecorder( StateDb& sdb, const Assets& assets )
+    : m_sdb( sdb )
+    , m_assets( assets )
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDbRecorder::~StateDbRecorder()
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDbRecorder::open( const std::string& filename )
+{
+    m_out.open( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !m_out ) {
+        Logger::debug( "ERROR: Failed to open recording \"%s\"", filename.c_str() );
+        return false;
+    }
+    u64 schemaHash = m_sdb.schemaHash();
+    m_out.write( RECORDING_MAGIC, sizeof( RECORDING_MAGIC ) );
+    m_out.write( (const char*)&RECORDING_FORMAT_VERSION, sizeof( u64 ) );
+    m_out.write( (const char*)&schemaHash, sizeof( u64 ) );
+
+    // Assets registered so far (e.g. during module initialization)
+    m_recordedAssets.clear();
+    m_frame.clear();
+    recordAssets( m_frame );
+    u64 assetsSizeInB = m_frame.size();
+    m_out.write( (const char*)&assetsSizeInB, sizeof( u64 ) );
+    m_out.write( (const char*)&m_frame[ 0 ], assetsSizeInB );
+
+    m_typeShadows.clear();
+    m_stateShadows.clear();
+    m_frameCount  = 0;
+    m_recordedInB = 4 * sizeof( u64 ) + assetsSizeInB;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDbRecorder::recordFrame()
+{
+    if ( !m_out.is_open() ) {
+        return;
+    }
+    COMMON_ASSERT( m_sdb.m_typeIdsWithPendingDestroys.empty() );
+
+    m_frame.clear();
+    writeVarint( m_frame, m_frameCount );
+    recordAssets( m_frame );
+
+    m_typeShadows.resize( m_sdb.m_types.size() );
+    for ( u64 typeId = 1; typeId < m_sdb.m_types.size(); ++typeId ) {
+        const StateDb::Type& type = m_sdb.m_types[ typeId ];
+        TypeShadow& shadow        = m_typeShadows[ typeId ];
+
+        u64 mapCount = type.objectCapacity + 1;
+        extendShadowMaps( shadow.objectIdToIdx, shadow.idxToObjectId, shadow.lifecycleByObjectId, mapCount );
+
+        u64 typeStartInB = m_frame.size();
+        writeVarint( m_frame, typeId );
+        writeVarint( m_frame, type.objectCount );
+        writeVarint( m_frame, type.objectCapacity );
+        u64 mapSizeInB = mapCount * sizeof( u64 );
+        u64 runCount   = 0;
+        runCount += writeRuns(
+            m_frame, (const unsigned char*)&type.objectIdToIdx[ 0 ],
+            (unsigned char*)&shadow.objectIdToIdx[ 0 ], mapSizeInB );
+        runCount += writeRuns(
+            m_frame, (const unsigned char*)&type.idxToObjectId[ 0 ],
+            (unsigned char*)&shadow.idxToObjectId[ 0 ], mapSizeInB );
+        runCount += writeRuns(
+            m_frame, (const unsigned char*)&type.lifecycleByObjectId[ 0 ],
+            (unsigned char*)&shadow.lifecycleByObjectId[ 0 ], mapSizeInB );
+        if ( !runCount && shadow.objectCount == type.objectCount
+             && shadow.objectCapacity == type.objectCapacity ) {
+            m_frame.resize( typeStartInB );
+            continue;
+        }
+        shadow.objectCount    = type.objectCount;
+        shadow.objectCapacity = type.objectCapacity;
+    }
+    writeVarint( m_frame, 0 );
+
+    m_stateShadows.resize( m_sdb.m_states.size() );
+    for ( u64 stateId = 1; stateId < m_sdb.m_states.size(); ++stateId ) {
+        const StateDb::State& state    = m_sdb.m_states[ stateId ];
+        const StateDb::StateData& data = m_sdb.m_stateData[ stateId ];
+        if ( !StateDb::isStored( state ) ) {
+            continue;
+        }
+
+        std::vector< unsigned char >& shadow = m_stateShadows[ stateId ];
+        u64 sizeInB                          = ( data.objectCount + 1 ) * data.elemSize;
+        resizeShadow( shadow, sizeInB, state.defaultElem );
+
+        u64 stateStartInB = m_frame.size();
+        writeVarint( m_frame, stateId );
+        if ( !writeRuns( m_frame, data.values, &shadow[ 0 ], sizeInB ) ) {
+            m_frame.resize( stateStartInB );
+        }
+    }
+    writeVarint( m_frame, 0 );
+
+    u64 frameSizeInB = m_frame.size();
+    m_out.write( (const char*)&frameSizeInB, sizeof( u64 ) );
+    m_out.write( (const char*)&m_frame[ 0 ], frameSizeInB );
+    m_recordedInB += sizeof( u64 ) + frameSizeInB;
+    ++m_frameCount;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDbRecorder::frameCount() const
+{
+    return m_frameCount;
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDbRecorder::recordedInB() const
+{
+    return m_recordedInB;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Writes hash, flags and name of assets registered since previous call
+void StateDbRecorder::recordAssets( std::vector< unsigned char >& out )
+{
+    // Assets are never unregistered ==> new ones are the ones not recorded yet
+    const std::map< u32, Assets::Info >& infos = m_assets.infos();
+    writeVarint( out, infos.size() - m_recordedAssets.size() );
+    if ( infos.size() == m_recordedAssets.size() ) {
+        return;
+    }
+    for ( auto& infoEntry : infos ) {
+        if ( !m_recordedAssets.insert( infoEntry.first ).second ) {
+            continue;
+        }
+        const Assets::Info& info = infoEntry.second;
+        writeVarint( out, info.hash );
+        writeVarint( out, info.flags );
+        writeVarint( out, info.name.size() );
+        out.insert( out.end(), info.name.begin(), info.name.end() );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDbPlayer::StateDbPlayer( StateDb& sdb, Assets& assets )
+    : m_sdb( sdb )
+    , m_assets( assets )
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+StateDbPlayer::~StateDbPlayer()
+{
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDbPlayer::open( const std::string& filename )
+{
+    m_in.open( filename.c_str(), std::ios::in | std::ios::binary );
+    char magic[ 8 ]   = {};
+    u64 formatVersion = 0;
+    u64 schemaHash    = 0;
+    u64 assetsSizeInB = 0;
+    m_in.read( magic, sizeof( magic ) );
+    m_in.read( (char*)&formatVersion, sizeof( u64 ) );
+    m_in.read( (char*)&schemaHash, sizeof( u64 ) );
+    m_in.read( (char*)&assetsSizeInB, sizeof( u64 ) );
+    if ( !m_in || memcmp( magic, RECORDING_MAGIC, sizeof( magic ) ) != 0
+         || formatVersion != RECORDING_FORMAT_VERSION ) {
+        Logger::debug( "ERROR: Failed to open recording \"%s\"", filename.c_str() );
+        m_in.close();
+        return false;
+    }
+    if ( schemaHash != m_sdb.schemaHash() ) {
+        Logger::debug( "ERROR: Recording \"%s\" does not match state database schema", filename.c_str() );
+        m_in.close();
+        return false;
+    }
+    // Assets have to be known before first frame (e.g. for meshes created during initialization)
+    bool valid = assetsSizeInB > 0;
+    if ( valid ) {
+        m_frame.resize( assetsSizeInB );
+        const unsigned char* cursor = &m_frame[ 0 ];
+        const unsigned char* end    = cursor + assetsSizeInB;
+        valid = m_in.read( (char*)&m_frame[ 0 ], assetsSizeInB ) && playAssets( cursor, end ) && cursor == end;
+    }
+    if ( !valid ) {
+        Logger::debug( "ERROR: Assets of recording \"%s\" are corrupt", filename.c_str() );
+        m_in.close();
+        return false;
+    }
+    m_typeShadows.clear();
+    m_stateShadows.clear();
+    m_frameCount = 0;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool StateDbPlayer::playFrame()
+{
+    u64 frameSizeInB = 0;
+    if ( !m_in.is_open() || !m_in.read( (char*)&frameSizeInB, sizeof( u64 ) ) ) {
+        return false;
+    }
+    m_frame.resize( frameSizeInB );
+    if ( !frameSizeInB || !m_in.read( (char*)&m_frame[ 0 ], frameSizeInB ) ) {
+        Logger::debug( "ERROR: Recording is truncated" );
+        return false;
+    }
+    m_sdb.assertNoParallelFor();
+
+    const unsigned char* cursor = &m_frame[ 0 ];
+    const unsigned char* end    = cursor + frameSizeInB;
+    u64 frameIdx                = 0;
+    bool valid                  = readVarint( cursor, end, frameIdx ) && frameIdx == m_frameCount
+        && playAssets( cursor, end );
+
+    u64 typeId = 0;
+    m_typeShadows.resize( m_sdb.m_types.size() );
+    while ( valid && ( valid = readVarint( cursor, end, typeId ) ) && typeId ) {
+        u64 objectCount    = 0;
+        u64 objectCapacity = 0;
+        valid = typeId < m_sdb.m_types.size() && readVarint( cursor, end, objectCount )
+            && readVarint( cursor, end, objectCapacity );
+        if ( !valid ) {
+            break;
+        }
+
+        TypeShadow& shadow = m_typeShadows[ typeId ];
+        u64 mapCount       = objectCapacity + 1;
+        u64 mapSizeInB     = mapCount * sizeof( u64 );
+        extendShadowMaps( shadow.objectIdToIdx, shadow.idxToObjectId, shadow.lifecycleByObjectId, mapCount );
+        valid = objectCount <= objectCapacity && shadow.objectIdToIdx.size() == mapCount
+            && applyRuns( cursor, end, (unsigned char*)&shadow.objectIdToIdx[ 0 ], mapSizeInB )
+            && applyRuns( cursor, end, (unsigned char*)&shadow.idxToObjectId[ 0 ], mapSizeInB )
+            && applyRuns( cursor, end, (unsigned char*)&shadow.lifecycleByObjectId[ 0 ], mapSizeInB );
+        if ( !valid ) {
+            break;
+        }
+
+        StateDb::Type& type = m_sdb.m_types[ typeId ];
+        while ( type.objectCapacity < objectCapacity ) {
+            if ( !m_sdb.growType( type ) ) {
+                break;
+            }
+        }
+        valid = type.objectCapacity == objectCapacity;
+        if ( !valid ) {
+            break;
+        }
+        // Lifecycle events are derived from ID maps before/after applying frame
+        bool journaled = !type.journal.cursorSeqs.empty();
+        if ( journaled ) {
+            m_prevObjectIdToIdx       = type.objectIdToIdx;
+            m_prevIdxToObjectId       = type.idxToObjectId;
+            m_prevLifecycleByObjectId = type.lifecycleByObjectId;
+        }
+        memcpy( &type.objectIdToIdx[ 0 ], &shadow.objectIdToIdx[ 0 ], mapSizeInB );
+        memcpy( &type.idxToObjectId[ 0 ], &shadow.idxToObjectId[ 0 ], mapSizeInB );
+        memcpy( &type.lifecycleByObjectId[ 0 ], &shadow.lifecycleByObjectId[ 0 ], mapSizeInB );
+
+        u64 prevObjectCount = type.objectCount;
+        type.objectCount    = objectCount;
+        m_sdb.updateObjectCount( type );
+        ++type.layoutVersion;
+        // Keep unused elements at default values (like destruction does)
+        if ( objectCount < prevObjectCount ) {
+            for ( u64 stateId : type.stateIds ) {
+                m_sdb.resetElems( stateId, objectCount + 1, prevObjectCount - objectCount );
+            }
+        }
+        else if ( objectCount > prevObjectCount ) {
+            m_sdb.markObjectsDirty( type, prevObjectCount + 1, objectCount - prevObjectCount );
+        }
+        if ( journaled ) {
+            journalLifecycles( typeId, prevObjectCount );
+        }
+    }
+
+    // Shadows follow object counts of this frame (the same way shadows of 'StateDbRecorder' do)
+    m_stateShadows.resize( m_sdb.m_states.size() );
+    for ( u64 stateId = 1; valid && stateId < m_sdb.m_states.size(); ++stateId ) {
+        const StateDb::State& state    = m_sdb.m_states[ stateId ];
+        const StateDb::StateData& data = m_sdb.m_stateData[ stateId ];
+        if ( StateDb::isStored( state ) ) {
+            u64 sizeInB = ( data.objectCount + 1 ) * data.elemSize;
+            resizeShadow( m_stateShadows[ stateId ], sizeInB, state.defaultElem );
+        }
+    }
+
+    u64 stateId = 0;
+    std::vector< std::pair< u64, u64 > > appliedRuns;
+    while ( valid && ( valid = readVarint( cursor, end, stateId ) ) && stateId ) {
+        valid = stateId < m_sdb.m_states.size() && StateDb::isStored( m_sdb.m_states[ stateId ] );
+        if ( !valid ) {
+            break;
+        }
+        const StateDb::StateData& data       = m_sdb.m_stateData[ stateId ];
+        std::vector< unsigned char >& shadow = m_stateShadows[ stateId ];
+        appliedRuns.clear();
+        valid = applyRuns( cursor, end, &shadow[ 0 ], shadow.size(), &appliedRuns );
+        for ( u64 runIdx = 0; valid && runIdx < appliedRuns.size(); ++runIdx ) {
+            // Recorded contents win over writes of modules since last frame
+            u64 offsetInB = appliedRuns[ runIdx ].first;
+            u64 sizeInB   = appliedRuns[ runIdx ].second;
+            memcpy( data.values + offsetInB, &shadow[ offsetInB ], sizeInB );
+            // Let change consumers see replayed writes
+            u64 firstIdx = std::max( offsetInB / data.elemSize, u64( 1 ) );
+            u64 lastIdx  = ( offsetInB + sizeInB - 1 ) / data.elemSize;
+            for ( u64 idx = firstIdx; data.changes && idx <= lastIdx; ++idx ) {
+                m_sdb.markDirty( data, idx );
+            }
+        }
+    }
+
+    if ( !valid || cursor != end ) {
+        Logger::debug( "ERROR: Recording frame %d is corrupt", int( m_frameCount ) );
+        m_in.close();
+        return false;
+    }
+    ++m_frameCount;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Registers assets written by 'StateDbRecorder::recordAssets()'
+bool StateDbPlayer::playAssets( const unsigned char*& cursor, const unsigned char* end )
+{
+    u64 assetCount = 0;
+    if ( !readVarint( cursor, end, assetCount ) ) {
+        return false;
+    }
+    for ( u64 assetIdx = 0; assetIdx < assetCount; ++assetIdx ) {
+        u64 hash       = 0;
+        u64 flags      = 0;
+        u64 nameLength = 0;
+        if ( !readVarint( cursor, end, hash ) || !readVarint( cursor, end, flags )
+             || !readVarint( cursor, end, nameLength ) || nameLength > u64( end - cursor ) ) {
+            return false;
+        }
+        std::string name( (const char*)cursor, nameLength );
+        cursor += nameLength;
+        // Recorded states refer to assets by hash ==> name has to hash the same way
+        if ( m_assets.asset( name, u32( flags ) ) != hash ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void StateDbPlayer::journalLifecycles( u64 typeId, u64 prevObjectCount )
+{
+    StateDb::Type& type = m_sdb.m_types[ typeId ];
+
+    // Objects are alive if they map to an index in use (and back)
+    auto wasAlive = [&]( u64 objectId ) {
+        u64 idx = m_prevObjectIdToIdx[ objectId ];
+        return idx >= 1 && idx <= prevObjectCount && m_prevIdxToObjectId[ idx ] == objectId;
+    };
+    auto isAlive = [&]( u64 objectId ) {
+        u64 idx = type.objectIdToIdx[ objectId ];
+        return idx >= 1 && idx <= type.objectCount && type.idxToObjectId[ idx ] == objectId;
+    };
+
+    // Destructions first (IDs of objects destroyed since last frame might have been reused)
+    for ( u64 objectId = 1; objectId <= type.objectCapacity; ++objectId ) {
+        u64 prevLifecycle = m_prevLifecycleByObjectId[ objectId ];
+        if ( wasAlive( objectId )
+             && ( !isAlive( objectId ) || type.lifecycleByObjectId[ objectId ] != prevLifecycle ) ) {
+            m_sdb.journalDestroy(
+                type, StateDb::composeObjectHandle( u16( typeId ), u16( prevLifecycle ), u32( objectId ) ) );
+        }
+    }
+    for ( u64 objectId = 1; objectId <= type.objectCapacity; ++objectId ) {
+        if ( isAlive( objectId )
+             && ( !wasAlive( objectId )
+                  || type.lifecycleByObjectId[ objectId ] != m_prevLifecycleByObjectId[ objectId ] ) ) {
+            m_sdb.journalCreates( type, type.objectIdToIdx[ objectId ], 1 );
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 StateDbPlayer::frameCount() const
+{
+    return m_frameCount;
+}
@@ -0,0 +1,124 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#ifndef STATEDBRECORDING_HPP
+#define STATEDBRECORDING_HPP
+
+#include "Common.hpp"
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+struct StateDb;
+struct Assets;
+
+// -------------------------------------------------------------------------------------------------
+/// @brief Records per-frame deltas of a state database into a streaming file
+///
+/// Every frame stores the bytes of ID maps, lifecycles and (non-'TRANSIENT') state arrays that
+/// changed since the previous frame. Arrays are compared in 64 B blocks and changed runs are stored
+/// XOR-ed with their previous contents and zero-run-length encoded (unchanged fields of changed
+/// elements compress to almost nothing). Object creation/destruction is captured through the ID
+/// maps, lifecycles and object counts. States only refer to assets by hash ==> names and flags of
+/// assets are stored in the header and (if registered later) in the frame registering them.
+struct StateDbRecorder
+{
+    StateDbRecorder( StateDb& sdb, const Assets& assets );
+    virtual ~StateDbRecorder();
+
+    bool open( const std::string& filename );
+
+    /// Records changes since previous frame (call after 'StateDb::flushDestroys()')
+    void recordFrame();
+
+    u64 frameCount() const;
+    u64 recordedInB() const;
+
+private:
+    struct TypeShadow
+    {
+        u64 objectCount    = 0;
+        u64 objectCapacity = 0;
+        std::vector< u64 > objectIdToIdx;
+        std::vector< u64 > idxToObjectId;
+        std::vector< u64 > lifecycleByObjectId;
+    };
+
+    StateDb& m_sdb;
+    const Assets& m_assets;
+    std::ofstream m_out;
+
+    // Hashes of assets stored so far
+    std::set< u32 > m_recordedAssets;
+
+    // Contents of state database as of previous frame (as seen by player)
+    std::vector< TypeShadow > m_typeShadows;
+    std::vector< std::vector< unsigned char > > m_stateShadows;
+
+    std::vector< unsigned char > m_frame;
+    u64 m_frameCount  = 0;
+    u64 m_recordedInB = 0;
+
+    void recordAssets( std::vector< unsigned char >& out );
+
+private:
+    COMMON_DISABLE_COPY( StateDbRecorder )
+};
+
+// -------------------------------------------------------------------------------------------------
+/// @brief Replays recording of 'StateDbRecorder' into state database with same schema
+///
+/// Recorded contents are tracked in shadows and written as a whole ==> modules updated in between
+/// frames may write states (changes of the recording overwrite them) but must not create, destroy
+/// or reorder objects. Objects created before the first frame (e.g. by module initialization) have
+/// to be created the same way as when recording. Creation/destruction of objects is journaled
+/// (lifecycle cursors see replayed objects). Recorded assets are registered with 'assets' (contents
+/// of procedural assets are not recorded ==> they stay empty).
+struct StateDbPlayer
+{
+    StateDbPlayer( StateDb& sdb, Assets& assets );
+    virtual ~StateDbPlayer();
+
+    bool open( const std::string& filename );
+
+    /// Applies next frame (returns false at end of recording or on error)
+    bool playFrame();
+
+    u64 frameCount() const;
+
+private:
+    struct TypeShadow
+    {
+        std::vector< u64 > objectIdToIdx;
+        std::vector< u64 > idxToObjectId;
+        std::vector< u64 > lifecycleByObjectId;
+    };
+
+    StateDb& m_sdb;
+    Assets& m_assets;
+    std::ifstream m_in;
+
+    // Contents of state database as of previous frame (as recorded)
+    std::vector< TypeShadow > m_typeShadows;
+    std::vector< std::vector< unsigned char > > m_stateShadows;
+
+    std::vector< unsigned char > m_frame;
+    u64 m_frameCount = 0;
+
+    // ID maps of type before applying frame (for journaling lifecycle events)
+    std::vector< u64 > m_prevObjectIdToIdx;
+    std::vector< u64 > m_prevIdxToObjectId;
+    std::vector< u64 > m_prevLifecycleByObjectId;
+
+    bool playAssets( const unsigned char*& cursor, const unsigned char* end );
+    void journalLifecycles( u64 typeId, u64 prevObjectCount );
+
+private:
+    COMMON_DISABLE_COPY( StateDbPlayer )
+};
+
+#endif
@@ -0,0 +1,366 @@
+// -------------------------------------------------------------------------------------------------
+/// @author Martin Moerth (MARTINMO)
+/// @date 17.10.2026
+// -------------------------------------------------------------------------------------------------
+
+#include "Common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined( __linux__ )
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Logger.hpp"
+#include "Physics.hpp"
+#include "Renderer.hpp"
+#include "StateDb.hpp"
+
+// Elements with the layout of the real states (wrapped as 'STATE' IDs are defined by the modules)
+struct MeshElem
+{
+    static u64 STATE;
+    Renderer::Mesh::Info info;
+};
+u64 MeshElem::STATE = 0;
+
+struct RigidBodyElem
+{
+    static u64 STATE;
+    Physics::RigidBody::Info info;
+};
+u64 RigidBodyElem::STATE = 0;
+
+// Every measurement is repeated and the fastest run is reported
+static const u64 REPEAT_COUNT = 3;
+// Loops over few objects are repeated to get above timer and counter resolution
+static const u64 MIN_OP_COUNT = 1 << 20;
+
+// -------------------------------------------------------------------------------------------------
+/// Counts last level cache misses of this thread in user space (Linux 'perf_event_open()' only)
+struct CacheMissCounter
+{
+    CacheMissCounter();
+    virtual ~CacheMissCounter();
+
+    bool isAvailable() const;
+    void start();
+    u64 stop();
+
+private:
+    int m_fd = -1;
+
+    COMMON_DISABLE_COPY( CacheMissCounter )
+};
+
+// -------------------------------------------------------------------------------------------------
+CacheMissCounter::CacheMissCounter()
+{
+#if defined( __linux__ )
+    perf_event_attr attr = {};
+    attr.size            = sizeof( attr );
+    attr.type            = PERF_TYPE_HARDWARE;
+    attr.config          = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled        = 1;
+    attr.exclude_kernel  = 1;
+    attr.exclude_hv      = 1;
+    m_fd                 = int( syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+#endif
+    if ( m_fd < 0 ) {
+        Logger::debug( "WARNING: Cache miss counter not available (reported as -1)" );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+CacheMissCounter::~CacheMissCounter()
+{
+#if defined( __linux__ )
+    if ( m_fd >= 0 ) {
+        close( m_fd );
+    }
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+bool CacheMissCounter::isAvailable() const
+{
+    return m_fd >= 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+void CacheMissCounter::start()
+{
+#if defined( __linux__ )
+    if ( m_fd >= 0 ) {
+        ioctl( m_fd, PERF_EVENT_IOC_RESET, 0 );
+        ioctl( m_fd, PERF_EVENT_IOC_ENABLE, 0 );
+    }
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+u64 CacheMissCounter::stop()
+{
+    u64 count = 0;
+#if defined( __linux__ )
+    if ( m_fd >= 0 ) {
+        ioctl( m_fd, PERF_EVENT_IOC_DISABLE, 0 );
+        if ( read( m_fd, &count, sizeof( count ) ) != sizeof( count ) ) {
+            count = 0;
+        }
+    }
+#endif
+    return count;
+}
+
+// -------------------------------------------------------------------------------------------------
+struct Result
+{
+    std::string benchmark;
+    std::string element;
+    u64 objectCount         = 0;
+    double nsPerOp          = 0.0;
+    // State bytes read, written or committed per operation (excluding StateDb bookkeeping)
+    double bytesPerOp       = 0.0;
+    double cacheMissesPerOp = -1.0;
+};
+
+// -------------------------------------------------------------------------------------------------
+struct Bench
+{
+    CacheMissCounter cacheMisses;
+    std::vector< Result > results;
+    // Keeps loops that only read from being optimized away
+    u64 sink = 0;
+
+    /// Runs 'setup()' (not measured) and 'run()' (measured) 'REPEAT_COUNT' times and records the
+    /// fastest run as 'opCount' operations
+    template< class Setup, class Run >
+    void measure(
+        const std::string& benchmark, const std::string& element, u64 objectCount, u64 opCount,
+        double bytesPerOp, Setup setup, Run run )
+    {
+        Result result;
+        result.benchmark   = benchmark;
+        result.element     = element;
+        result.objectCount = objectCount;
+        result.bytesPerOp  = bytesPerOp;
+        for ( u64 repeat = 0; repeat < REPEAT_COUNT; ++repeat ) {
+            setup();
+
+            auto begin = std::chrono::steady_clock::now();
+            cacheMisses.start();
+            run();
+            u64 missCount = cacheMisses.stop();
+            auto end      = std::chrono::steady_clock::now();
+
+            double nsPerOp = std::chrono::duration< double, std::nano >( end - begin ).count() / opCount;
+            if ( repeat == 0 || nsPerOp < result.nsPerOp ) {
+                result.nsPerOp          = nsPerOp;
+                result.cacheMissesPerOp = cacheMisses.isAvailable() ? double( missCount ) / opCount : -1.0;
+            }
+        }
+        results.push_back( result );
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+/// Database with a single type and state of 'ElementType' (registered like the real state)
+template< class ElementType >
+static std::unique_ptr< StateDb > createDb( u64 maxObjectCount, u64 stateFlags, u64& typeId )
+{
+    std::unique_ptr< StateDb > sdb( new StateDb );
+    typeId             = sdb->registerType( "Bench", maxObjectCount, StateDb::GROWABLE, 512 );
+    ElementType::STATE = sdb->registerState< ElementType >( typeId, "Info", stateFlags );
+    return sdb;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// Destroys remaining objects (from the back to avoid swapping) to keep destructor quiet
+static void destroyAll( StateDb& sdb, u64 typeId )
+{
+    for ( u64 idx = u64( sdb.count( typeId ) ); idx >= 1; --idx ) {
+        sdb.destroy( sdb.objectHandleByIdx( typeId, idx ) );
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+template< class ElementType >
+static void runBenchmarks( Bench& bench, const std::string& element, u64 stateFlags, u64 objectCount )
+{
+    const u64 innerRepeatCount = std::max( u64( 1 ), MIN_OP_COUNT / objectCount );
+    const double elemSizeInB   = double( sizeof( ElementType ) );
+    std::mt19937_64 random( 42 );
+
+    u64 typeId = 0;
+    std::unique_ptr< StateDb > sdb;
+    std::vector< u64 > handles( objectCount );
+    auto recreateDb = [&]() {
+        if ( sdb ) {
+            destroyAll( *sdb, typeId );
+        }
+        sdb = createDb< ElementType >( objectCount, stateFlags, typeId );
+    };
+    auto createObjects = [&]() {
+        for ( u64& handle : handles ) {
+            sdb->create< ElementType >( handle );
+        }
+    };
+    auto noSetup = []() {};
+
+    // Create into empty type (committing memory page by page, bytes are committed per object)
+    bench.measure( "create", element, objectCount, objectCount, 0.0, recreateDb, createObjects );
+    bench.results.back().bytesPerOp = double( sdb->typeStats( typeId ).committedInB ) / objectCount;
+
+    // Lookups in random order (typical for following handles stored in other states)
+    std::vector< u64 > shuffledHandles = handles;
+    std::shuffle( shuffledHandles.begin(), shuffledHandles.end(), random );
+    bench.measure(
+        "isHandleValid", element, objectCount, objectCount * innerRepeatCount, 0.0, noSetup, [&]() {
+            for ( u64 repeat = 0; repeat < innerRepeatCount; ++repeat ) {
+                for ( u64 handle : shuffledHandles ) {
+                    bench.sink += sdb->isHandleValid( handle );
+                }
+            }
+        } );
+    bench.measure(
+        "state", element, objectCount, objectCount * innerRepeatCount, elemSizeInB, noSetup, [&]() {
+            for ( u64 repeat = 0; repeat < innerRepeatCount; ++repeat ) {
+                for ( u64 handle : shuffledHandles ) {
+                    bench.sink += sdb->state< ElementType >( handle )->info.flags;
+                }
+            }
+        } );
+
+    // Linear iteration
+    bench.measure(
+        "stateAll", element, objectCount, objectCount * innerRepeatCount, elemSizeInB, noSetup, [&]() {
+            for ( u64 repeat = 0; repeat < innerRepeatCount; ++repeat ) {
+                for ( ElementType* elem : sdb->stateAll< ElementType >() ) {
+                    bench.sink += elem->info.flags;
+                }
+            }
+        } );
+    bench.measure(
+        "handleFromState", element, objectCount, objectCount * innerRepeatCount, 0.0, noSetup, [&]() {
+            for ( u64 repeat = 0; repeat < innerRepeatCount; ++repeat ) {
+                for ( ElementType* elem : sdb->stateAll< ElementType >() ) {
+                    bench.sink += sdb->handleFromState( elem );
+                }
+            }
+        } );
+
+    // Destroy random object immediately (swap-remove) and create replacement, copies last element
+    // into hole, resets last element and initializes new element
+    const u64 churnOpCount = std::max( objectCount, MIN_OP_COUNT );
+    std::vector< u64 > churnPositions( churnOpCount );
+    for ( u64& position : churnPositions ) {
+        position = random() % objectCount;
+    }
+    bench.measure( "churn", element, objectCount, churnOpCount, 3.0 * elemSizeInB, noSetup, [&]() {
+        for ( u64 position : churnPositions ) {
+            sdb->destroy( handles[ position ] );
+            sdb->create< ElementType >( handles[ position ] );
+        }
+    } );
+
+    // Batch compaction of half of the objects destroyed in random order (deferred)
+    bench.measure(
+        "flushDestroys", element, objectCount, objectCount / 2, 2.0 * elemSizeInB,
+        [&]() {
+            recreateDb();
+            createObjects();
+            std::shuffle( handles.begin(), handles.end(), random );
+            for ( u64 handleIdx = 0; handleIdx < objectCount / 2; ++handleIdx ) {
+                sdb->destroyDeferred( handles[ handleIdx ] );
+            }
+        },
+        [&]() { sdb->flushDestroys(); } );
+
+    destroyAll( *sdb, typeId );
+}
+
+// -------------------------------------------------------------------------------------------------
+static bool writeCsv(
+    const std::string& filename, const std::string& label, const std::vector< Result >& results )
+{
+    FILE* file = fopen( filename.c_str(), "w" );
+    if ( !file ) {
+        Logger::debug( "ERROR: Failed to open \"%s\"", filename.c_str() );
+        return false;
+    }
+    fprintf( file, "label,benchmark,element,objects,ns_per_op,bytes_per_op,cache_misses_per_op\n" );
+    for ( const Result& result : results ) {
+        fprintf(
+            file, "%s,%s,%s,%llu,%.3f,%.1f,%.4f\n", label.c_str(), result.benchmark.c_str(),
+            result.element.c_str(), (unsigned long long)result.objectCount, result.nsPerOp, result.bytesPerOp,
+            result.cacheMissesPerOp );
+    }
+    return fclose( file ) == 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+/// StateDb microbenchmarks (build release configuration for meaningful numbers)
+///
+///   StateDbBench [--csv <file>] [--label <revision>] [--max-objects <count>]
+///
+/// Results are written to CSV (one row per benchmark, element and object count) tagged with the
+/// given label so that results of different revisions can be concatenated and compared.
+int main( int argc, char* argv[] )
+{
+    Logger logging;
+
+    std::string csvFilename;
+    std::string label  = "unlabeled";
+    u64 maxObjectCount = 1 << 20;
+    for ( int argIdx = 1; argIdx < argc; ++argIdx ) {
+        std::string arg = argv[ argIdx ];
+        if ( arg == "--csv" && argIdx + 1 < argc ) {
+            csvFilename = argv[ ++argIdx ];
+        }
+        else if ( arg == "--label" && argIdx + 1 < argc ) {
+            label = argv[ ++argIdx ];
+        }
+        else if ( arg == "--max-objects" && argIdx + 1 < argc ) {
+            maxObjectCount = u64( strtoull( argv[ ++argIdx ], nullptr, 10 ) );
+        }
+        else {
+            Logger::debug(
+                "Usage: StateDbBench [--csv <file>] [--label <revision>] [--max-objects <count>]" );
+            return EXIT_FAILURE;
+        }
+    }
+
+    Bench bench;
+    const u64 objectCounts[] = { 1 << 10, 1 << 16, 1 << 20 };
+    for ( u64 objectCount : objectCounts ) {
+        if ( objectCount > maxObjectCount ) {
+            continue;
+        }
+        runBenchmarks< MeshElem >( bench, "Mesh", StateDb::TRACK_CHANGES, objectCount );
+        runBenchmarks< RigidBodyElem >( bench, "RigidBody", 0, objectCount );
+    }
+    for ( const Result& result : bench.results ) {
+        Logger::debug(
+            "%-16s %-10s %8llu %10.2f ns/op %8.1f B/op %8.3f misses/op", result.benchmark.c_str(),
+            result.element.c_str(), (unsigned long long)result.objectCount, result.nsPerOp, result.bytesPerOp,
+            result.cacheMissesPerOp );
+    }
+    // Printed so that the compiler cannot drop any of the measured loops
+    Logger::debug( "(sink %llu)", (unsigned long long)( bench.sink & 0xff ) );
+
+    if ( !csvFilename.empty() && !writeCsv( csvFilename, label, bench.results ) ) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+TEMPLATE = app
+
+CONFIG -= QT
+QT -= core gui
+
+# Timings of debug builds are meaningless
+CONFIG += console release
+CONFIG -= debug debug_and_release flat
+
+win32 {
+    # Treat all source files as C++
+    QMAKE_CXXFLAGS += /TP
+
+    # Define warning level
+    QMAKE_CXXFLAGS_WARN_ON  = /W4
+    # 'identifier' : unreferenced formal parameter
+    QMAKE_CXXFLAGS_WARN_ON += /wd4100
+    # nonstandard extension used : nameless struct/union
+    QMAKE_CXXFLAGS_WARN_ON += /wd4201
+    # 'function': This function or variable may be unsafe
+    QMAKE_CXXFLAGS_WARN_ON += /wd4996
+}
+unix {
+    # Enable C++11 support
+    QMAKE_CXXFLAGS += -std=c++11
+    QMAKE_CXXFLAGS += -pthread
+    QMAKE_LFLAGS += -pthread
+}
+linux {
+    # 'shm_open()' on older glibc
+    LIBS += -lrt
+}
+
+THIRDPARTY = ../Thirdparty
+
+# =====  OpenGL Mathematics (GLM) = http://glm.g-truc.net ==========================================
+# Needed for the layouts of the benchmarked states (same settings as the prototype)
+win32 | unix {
+    INCLUDEPATH += $${THIRDPARTY}/Glm
+    DEFINES += GLM_FORCE_PURE
+    DEFINES += GLM_FORCE_CTOR_INIT
+}
+
+# ==================================================================================================
+
+# Benchmarks StateDb in isolation (no modules, only the state layouts are taken from the prototype)
+PROTOTYPE = ../Prototype
+
+INCLUDEPATH += $${PROTOTYPE}
+
+HEADERS += \
+    $${PROTOTYPE}/Common.hpp \
+    $${PROTOTYPE}/JobSystem.hpp \
+    $${PROTOTYPE}/Logger.hpp \
+    $${PROTOTYPE}/Physics.hpp \
+    $${PROTOTYPE}/Platform.hpp \
+    $${PROTOTYPE}/Renderer.hpp \
+    $${PROTOTYPE}/StateDb.hpp
+
+SOURCES += \
+    Main.cpp \
+    $${PROTOTYPE}/JobSystem.cpp \
+    $${PROTOTYPE}/Logger.cpp \
+    $${PROTOTYPE}/Platform.cpp \
+    $${PROTOTYPE}/StateDb.cpp